@@ -0,0 +1,49 @@
+// GFLOP/s of the blocked GEMM kernel against the plain triple loop for
+// square n x n products, single-threaded.
+// Build and run from the repository root:
+//   g++ -std=c++14 -O3 -march=native -pthread bench/gemm.cpp -o gemm && ./gemm
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../matrix/gemm.hpp"
+
+// Seconds per call of product, taking the best of a few runs.
+template<typename F>
+double bestTime(F product) {
+  double best = 1e30;
+  for (int run = 0; run < 3; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    product();
+    auto finish = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(finish - start).count());
+  }
+  return best;
+}
+
+template<typename T>
+void report(const char* type) {
+  std::mt19937 random(1);
+  for (size_t n : {64, 128, 256, 512, 1024}) {
+    std::vector<T> a(n * n), b(n * n), c(n * n);
+    for (size_t i = 0; i < n * n; ++i) {
+      a[i] = T(random() % 16);
+      b[i] = T(random() % 16);
+    }
+    double flops = 2.0 * n * n * n;
+    double blocked = bestTime([&] { gemm(a.data(), b.data(), c.data(), n, n, n); });
+    double naive = bestTime([&] {
+      gemmNaive(a.data(), b.data(), c.data(), n, n, n, n, n, n);
+    });
+    std::cout << type << "\t" << n << "\t" << flops / blocked * 1e-9 << "\t"
+              << flops / naive * 1e-9 << "\n";
+  }
+}
+
+int main() {
+  std::cout << "type\tn\tblocked GFLOP/s\tnaive GFLOP/s\n";
+  report<double>("double");
+  report<float>("float");
+  report<int64_t>("int64");
+}
@@ -0,0 +1,47 @@
+// Microbenchmark for Residue<N>::pow and PowTable<N>::pow.
+// Build and run from the repository root:
+//   g++ -std=c++14 -O2 bench/residue_pow.cpp -o residue_pow && ./residue_pow
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../residue/residue.hpp"
+
+const unsigned Modulus = 1000000007;
+typedef Residue<Modulus> R;
+
+// The recursive square-and-multiply that Residue::pow used to be, for
+// reference.
+R recursivePow(const R& x, unsigned k) {
+  if (k == 0)
+    return R(1);
+  R half = recursivePow(x, k / 2);
+  return k % 2 == 0 ? half * half : half * half * x;
+}
+
+template<typename F>
+void run(const char* name, const std::vector<unsigned>& exponents, F pow) {
+  unsigned checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned k : exponents)
+    checksum += static_cast<unsigned>(static_cast<int>(pow(k)));
+  auto finish = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(finish - start).count();
+  std::cout << name << ": " << ns / exponents.size() << " ns/op (checksum " << checksum
+            << ")\n";
+}
+
+int main() {
+  const size_t count = 1 << 20;
+  std::mt19937 random(12345);
+  std::vector<unsigned> exponents(count);
+  for (unsigned& k : exponents)
+    k = random();
+  R base(123456789);
+  PowTable<Modulus> table(base);
+  std::cout << count << " random 32-bit exponents modulo " << Modulus << "\n";
+  run("recursive pow ", exponents, [&](unsigned k) { return recursivePow(base, k); });
+  run("Residue::pow  ", exponents, [&](unsigned k) { return base.pow(k); });
+  run("PowTable::pow ", exponents, [&](unsigned k) { return table.pow(k); });
+}
@@ -0,0 +1,79 @@
+// Seconds per square n x n product of Rational and BigInteger matrices:
+// the tiled i-k-j product of parallelGemm against the Strassen-Winograd
+// recursion of square_gemm, on one thread and on the whole pool.
+// Build and run from the repository root:
+//   g++ -std=c++14 -O2 -pthread bench/strassen.cpp -o strassen && ./strassen
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../BigInteger_and_Rational/BigInteger_and_Rational.hpp"
+#include "../matrix/gemm.hpp"
+
+// Seconds per call of product, taking the better of two runs.
+template<typename F>
+double bestTime(F product) {
+  double best = 1e30;
+  for (int run = 0; run < 2; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    product();
+    auto finish = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(finish - start).count());
+  }
+  return best;
+}
+
+template<typename T>
+T randomElement(std::mt19937& random);
+
+// 50-digit integers: the longer the elements, the more a multiplication
+// costs relative to an addition and the more Strassen-Winograd saves.
+template<>
+BigInteger randomElement<BigInteger>(std::mt19937& random) {
+  std::string digits(1, char('1' + random() % 9));
+  while (digits.size() < 50) {
+    digits += char('0' + random() % 10);
+  }
+  return BigInteger(digits);
+}
+
+template<>
+Rational randomElement<Rational>(std::mt19937& random) {
+  return Rational(int(random() % 2000) - 1000) / Rational(int(random() % 4) + 1);
+}
+
+template<typename T>
+void report(const char* type, size_t threads) {
+  ThreadPool::setGlobalThreads(threads);
+  std::mt19937 random(1);
+  for (size_t n : {16, 32, 64}) {
+    std::vector<T> a(n * n), b(n * n), c(n * n), d(n * n);
+    for (size_t i = 0; i < n * n; ++i) {
+      a[i] = randomElement<T>(random);
+      b[i] = randomElement<T>(random);
+    }
+    double tiled = bestTime([&] {
+      std::fill(c.begin(), c.end(), T(0));
+      parallelGemm(a.data(), b.data(), c.data(), n, n, n);
+    });
+    double strassen = bestTime([&] {
+      std::fill(d.begin(), d.end(), T(0));
+      square_gemm<T>::multiply(a.data(), b.data(), d.data(), n);
+    });
+    std::cout << type << "\t" << threads << "\t" << n << "\t" << tiled << "\t" << strassen
+              << "\t" << (c == d ? "equal" : "DIFFERENT") << "\n";
+  }
+}
+
+int main() {
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << "type\tthreads\tn\ttiled s\tStrassen s\tresults\n";
+  report<BigInteger>("BigInteger", 1);
+  report<Rational>("Rational", 1);
+  if (threads > 1) {
+    report<BigInteger>("BigInteger", threads);
+    report<Rational>("Rational", threads);
+  }
+}
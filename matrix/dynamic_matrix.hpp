@@ -0,0 +1,150 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+#include "matrix.hpp"
+
+// Matrix whose dimensions are known only at runtime. Elements live in one
+// aligned row-major block and products go through the same gemm() kernels
+// as Matrix<H, W, T>. Operations on mismatched dimensions throw
+// std::invalid_argument.
+template <typename T = int64_t>
+class DynamicMatrix {
+ private:
+  size_t rows_ = 0;
+  size_t cols_ = 0;
+  AlignedBuffer<T> a_;
+
+  void checkSameShape(const DynamicMatrix& rhs) const {
+    if (rows_ != rhs.rows_ || cols_ != rhs.cols_) {
+      throw std::invalid_argument("DynamicMatrix dimensions do not match");
+    }
+  }
+
+ public:
+  DynamicMatrix() = default;
+  DynamicMatrix(size_t rows, size_t cols) : DynamicMatrix(rows, cols, T(0)) {}
+  DynamicMatrix(size_t rows, size_t cols, const T& elem)
+      : rows_(rows), cols_(cols), a_(rows * cols) {
+    std::fill(a_.data(), a_.data() + rows_ * cols_, elem);
+  }
+  DynamicMatrix(const std::vector<std::vector<T>>& matrix)
+      : DynamicMatrix(matrix.size(), matrix.empty() ? 0 : matrix[0].size()) {
+    for (size_t idx = 0; idx < rows_; ++idx) {
+      for (size_t jdx = 0; jdx < cols_; ++jdx) {
+        (*this)(idx, jdx) = matrix[idx][jdx];
+      }
+    }
+  }
+  DynamicMatrix(const DynamicMatrix&) = default;
+  // The shape moves together with the elements; the source is left 0 x 0.
+  DynamicMatrix(DynamicMatrix&& matrix) noexcept
+      : rows_(matrix.rows_), cols_(matrix.cols_), a_(std::move(matrix.a_)) {
+    matrix.rows_ = 0;
+    matrix.cols_ = 0;
+  }
+  DynamicMatrix& operator=(const DynamicMatrix&) = default;
+  DynamicMatrix& operator=(DynamicMatrix&& matrix) noexcept {
+    std::swap(rows_, matrix.rows_);
+    std::swap(cols_, matrix.cols_);
+    std::swap(a_, matrix.a_);
+    return *this;
+  }
+  template <size_t H, size_t W>
+  DynamicMatrix(const Matrix<H, W, T>& matrix) : rows_(H), cols_(W), a_(H * W) {
+    std::copy(matrix.data(), matrix.data() + H * W, a_.data());
+  }
+  template <size_t H, size_t W>
+  explicit operator Matrix<H, W, T>() const {
+    if (rows_ != H || cols_ != W) {
+      throw std::invalid_argument("DynamicMatrix does not fit the Matrix shape");
+    }
+    Matrix<H, W, T> matr;
+    std::copy(a_.data(), a_.data() + H * W, matr.data());
+    return matr;
+  }
+  size_t Rows() const { return rows_; }
+  size_t Columns() const { return cols_; }
+  T& operator()(const size_t& idx, const size_t& jdx) {
+    return a_.data()[idx * cols_ + jdx];
+  }
+  const T& operator()(const size_t& idx, const size_t& jdx) const {
+    return a_.data()[idx * cols_ + jdx];
+  }
+  T* data() { return a_.data(); }
+  const T* data() const { return a_.data(); }
+  bool operator==(const DynamicMatrix& rhs) const {
+    if (rows_ != rhs.rows_ || cols_ != rhs.cols_) {
+      return false;
+    }
+    for (size_t idx = 0; idx < rows_ * cols_; ++idx) {
+      if (a_.data()[idx] != rhs.a_.data()[idx]) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool operator!=(const DynamicMatrix& rhs) const { return !(*this == rhs); }
+  friend DynamicMatrix operator*(const DynamicMatrix& lhs,
+                                 const DynamicMatrix& rhs) {
+    if (lhs.cols_ != rhs.rows_) {
+      throw std::invalid_argument("DynamicMatrix dimensions do not match");
+    }
+    DynamicMatrix matr(lhs.rows_, rhs.cols_);
+    parallelGemm(lhs.data(), rhs.data(), matr.data(), lhs.rows_, lhs.cols_, rhs.cols_);
+    return matr;
+  }
+  friend DynamicMatrix operator*(const T& lhs, DynamicMatrix rhs) {
+    rhs *= lhs;
+    return rhs;
+  }
+  friend DynamicMatrix operator*(DynamicMatrix lhs, const T& rhs) {
+    lhs *= rhs;
+    return lhs;
+  }
+  DynamicMatrix& operator*=(const DynamicMatrix& rhs) {
+    return *this = *this * rhs;
+  }
+  DynamicMatrix& operator*=(const T& rhs) {
+    for (size_t idx = 0; idx < rows_ * cols_; ++idx) {
+      a_.data()[idx] *= rhs;
+    }
+    return *this;
+  }
+  DynamicMatrix operator+() const { return *this; }
+  DynamicMatrix operator-() const { return *this * T(-1); }
+  DynamicMatrix& operator+=(const DynamicMatrix& rhs) {
+    checkSameShape(rhs);
+    for (size_t idx = 0; idx < rows_ * cols_; ++idx) {
+      a_.data()[idx] += rhs.a_.data()[idx];
+    }
+    return *this;
+  }
+  DynamicMatrix& operator-=(const DynamicMatrix& rhs) {
+    checkSameShape(rhs);
+    for (size_t idx = 0; idx < rows_ * cols_; ++idx) {
+      a_.data()[idx] -= rhs.a_.data()[idx];
+    }
+    return *this;
+  }
+  friend DynamicMatrix operator+(DynamicMatrix lhs, const DynamicMatrix& rhs) {
+    lhs += rhs;
+    return lhs;
+  }
+  friend DynamicMatrix operator-(DynamicMatrix lhs, const DynamicMatrix& rhs) {
+    lhs -= rhs;
+    return lhs;
+  }
+  DynamicMatrix Transposed() const {
+    DynamicMatrix matr(cols_, rows_);
+    transpose(data(), matr.data(), rows_, cols_, cols_, rows_);
+    return matr;
+  }
+  T Trace() const {
+    T matr = T(0);
+    for (size_t i = 0; i < std::min(rows_, cols_); ++i) {
+      matr += (*this)(i, i);
+    }
+    return matr;
+  }
+};
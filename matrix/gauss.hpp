@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+class BigInteger;
+class Rational;
+
+// Exact types whose entries grow under plain elimination use Bareiss'
+// fraction-free scheme: every intermediate entry is a minor of the input,
+// so BigInteger and built-in integers stay integral (their divisions are
+// exact) and Rational keeps small numerators and denominators.
+template<typename T>
+struct use_bareiss {
+  static const bool value = std::is_integral<T>::value;
+};
+
+template<>
+struct use_bareiss<BigInteger> {
+  static const bool value = true;
+};
+
+template<>
+struct use_bareiss<Rational> {
+  static const bool value = true;
+};
+
+// Floating point picks the largest pivot for stability, exact types take
+// the first nonzero one. Returns `to` when column c is zero in [from, to).
+template<typename T, bool Floating = std::is_floating_point<T>::value>
+struct pivot_rule {
+  static size_t find(const T* a, size_t ld, size_t from, size_t to, size_t c) {
+    for (size_t i = from; i < to; ++i) {
+      if (a[i * ld + c] != T(0)) {
+        return i;
+      }
+    }
+    return to;
+  }
+};
+
+template<typename T>
+struct pivot_rule<T, true> {
+  static size_t find(const T* a, size_t ld, size_t from, size_t to, size_t c) {
+    size_t best = to;
+    for (size_t i = from; i < to; ++i) {
+      if (a[i * ld + c] != T(0) &&
+          (best == to || std::abs(a[i * ld + c]) > std::abs(a[best * ld + c]))) {
+        best = i;
+      }
+    }
+    return best;
+  }
+};
+
+// One elimination step with pivot a(r, c): clears column c below row r and
+// applies the same row operations to the w columns of b.
+template<typename T, bool Bareiss = use_bareiss<T>::value>
+struct elimination_step {
+  // Plain Gaussian elimination over a field: one division per pivot.
+  static void apply(T* a, size_t rows, size_t cols, T* b, size_t w,
+                    size_t r, size_t c, T& det, T& /*prev*/) {
+    const T inverse = T(1) / a[r * cols + c];
+    for (size_t i = r + 1; i < rows; ++i) {
+      if (a[i * cols + c] == T(0)) {
+        continue;
+      }
+      const T factor = a[i * cols + c] * inverse;
+      for (size_t j = c + 1; j < cols; ++j) {
+        a[i * cols + j] -= factor * a[r * cols + j];
+      }
+      for (size_t j = 0; j < w; ++j) {
+        b[i * w + j] -= factor * b[r * w + j];
+      }
+      a[i * cols + c] = T(0);
+    }
+    det *= a[r * cols + c];
+  }
+};
+
+template<typename T>
+struct elimination_step<T, true> {
+  // Bareiss: x(i, j) <- (x(i, j) * pivot - x(i, c) * x(r, j)) / previous
+  // pivot, where the division is exact.
+  static void apply(T* a, size_t rows, size_t cols, T* b, size_t w,
+                    size_t r, size_t c, T& det, T& prev) {
+    const T pivot = a[r * cols + c];
+    for (size_t i = r + 1; i < rows; ++i) {
+      const T q = a[i * cols + c];
+      for (size_t j = c + 1; j < cols; ++j) {
+        a[i * cols + j] = (a[i * cols + j] * pivot - q * a[r * cols + j]) / prev;
+      }
+      for (size_t j = 0; j < w; ++j) {
+        b[i * w + j] = (b[i * w + j] * pivot - q * b[r * w + j]) / prev;
+      }
+      a[i * cols + c] = T(0);
+    }
+    // The last Bareiss pivot of a full-rank square matrix is its determinant.
+    det = pivot;
+    prev = pivot;
+  }
+};
+
+// Forward elimination of the row-major rows x cols matrix a to row echelon
+// form, in place, applying the row operations to b (rows x w) as well.
+// Returns the rank; det receives the determinant when a is square.
+template<typename T>
+size_t rowEchelon(T* a, size_t rows, size_t cols, T* b, size_t w, T& det) {
+  T prev = T(1);
+  bool negate = false;
+  size_t r = 0;
+  det = T(1);
+  for (size_t c = 0; c < cols && r < rows; ++c) {
+    size_t p = pivot_rule<T>::find(a, cols, r, rows, c);
+    if (p == rows) {
+      continue;
+    }
+    if (p != r) {
+      for (size_t j = 0; j < cols; ++j) {
+        std::swap(a[p * cols + j], a[r * cols + j]);
+      }
+      for (size_t j = 0; j < w; ++j) {
+        std::swap(b[p * w + j], b[r * w + j]);
+      }
+      negate = !negate;
+    }
+    elimination_step<T>::apply(a, rows, cols, b, w, r, c, det, prev);
+    ++r;
+  }
+  if (r < rows || r < cols) {
+    det = T(0);
+  } else if (negate) {
+    det = T(0) - det;
+  }
+  return r;
+}
+
+// Solves a x = b for the nonsingular upper triangular n x n a produced by
+// rowEchelon, overwriting b (n x w) with x.
+template<typename T>
+void backSubstitution(const T* a, size_t n, T* b, size_t w) {
+  for (size_t i = n; i > 0; --i) {
+    size_t row = i - 1;
+    for (size_t j = 0; j < w; ++j) {
+      T sum = b[row * w + j];
+      for (size_t k = row + 1; k < n; ++k) {
+        sum -= a[row * n + k] * b[k * w + j];
+      }
+      b[row * w + j] = sum / a[row * n + row];
+    }
+  }
+}
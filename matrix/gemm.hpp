@@ -0,0 +1,686 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "thread_pool.hpp"
+
+class BigInteger;
+class Rational;
+
+template<unsigned N>
+class Residue;
+
+// Kernels computing C += A * B on row-major storage, where A is m x k,
+// B is k x n and lda, ldb, ldc are the row strides of the three operands.
+// With transposedB, b holds B^T instead (n x k, B(p, j) = b[j * ldb + p]),
+// so A * B^T needs no transposed copy.
+
+template<typename T>
+struct is_gemm_arithmetic {
+  static const bool value = std::is_same<T, float>::value || std::is_same<T, double>::value ||
+                            std::is_same<T, int64_t>::value;
+};
+
+template<typename T>
+void gemmNaive(const T* a, const T* b, T* c, size_t m, size_t k, size_t n,
+               size_t lda, size_t ldb, size_t ldc, bool transposedB = false) {
+  if (transposedB) {
+    // Rows of A against rows of b: both are read contiguously.
+    for (size_t i = 0; i < m; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        T sum = T(0);
+        for (size_t p = 0; p < k; ++p) {
+          sum += a[i * lda + p] * b[j * ldb + p];
+        }
+        c[i * ldc + j] += sum;
+      }
+    }
+    return;
+  }
+  for (size_t i = 0; i < m; ++i) {
+    for (size_t p = 0; p < k; ++p) {
+      const T& x = a[i * lda + p];
+      for (size_t j = 0; j < n; ++j) {
+        c[i * ldc + j] += x * b[p * ldb + j];
+      }
+    }
+  }
+}
+
+// Goto-style blocked product: a kc x nc panel of B and an mc x kc block of A
+// are packed into contiguous slivers so that the micro-kernel streams both
+// from L1/L2, and every mr x nr tile of C is accumulated in registers.
+template<typename T>
+class BlockedGemm {
+  static const size_t mr = 6;
+  static const size_t nr = 64 / sizeof(T);
+  static const size_t kc = 256;
+  static const size_t mc = 96;
+  static const size_t nc = 2048;
+
+  // Rows of A in slivers of mr, column by column, zero padded.
+  static void packA(const T* a, size_t lda, size_t rows, size_t depth, T* packed) {
+    for (size_t i = 0; i < rows; i += mr) {
+      size_t height = std::min(mr, rows - i);
+      for (size_t p = 0; p < depth; ++p) {
+        for (size_t r = 0; r < mr; ++r) {
+          *packed++ = r < height ? a[(i + r) * lda + p] : T(0);
+        }
+      }
+    }
+  }
+
+  // Columns of B in slivers of nr, row by row, zero padded.
+  static void packB(const T* b, size_t ldb, size_t depth, size_t cols, T* packed,
+                    bool transposedB) {
+    if (transposedB) {
+      for (size_t j = 0; j < cols; j += nr) {
+        size_t width = std::min(nr, cols - j);
+        for (size_t p = 0; p < depth; ++p) {
+          for (size_t r = 0; r < nr; ++r) {
+            *packed++ = r < width ? b[(j + r) * ldb + p] : T(0);
+          }
+        }
+      }
+      return;
+    }
+    for (size_t j = 0; j < cols; j += nr) {
+      size_t width = std::min(nr, cols - j);
+      for (size_t p = 0; p < depth; ++p) {
+        for (size_t r = 0; r < nr; ++r) {
+          *packed++ = r < width ? b[p * ldb + j + r] : T(0);
+        }
+      }
+    }
+  }
+
+  static void microKernel(size_t depth, const T* a, const T* b, T* c, size_t ldc,
+                          size_t height, size_t width) {
+    T acc[mr][nr] = {};
+    // Loop order chosen so that compilers keep acc in vector registers and
+    // broadcast the elements of A instead of shuffling the accumulators.
+    for (size_t p = 0; p < depth; ++p) {
+      for (size_t j = 0; j < nr; ++j) {
+        T y = b[p * nr + j];
+        for (size_t i = 0; i < mr; ++i) {
+          acc[i][j] += a[p * mr + i] * y;
+        }
+      }
+    }
+    for (size_t i = 0; i < height; ++i) {
+      for (size_t j = 0; j < width; ++j) {
+        c[i * ldc + j] += acc[i][j];
+      }
+    }
+  }
+
+ public:
+  // Elements of the packed panels for products with n columns.
+  static size_t scratchSize(size_t n) {
+    return (mc + mr - 1) / mr * mr * kc + kc * ((std::min(nc, n) + nr - 1) / nr * nr);
+  }
+
+  static void multiply(const T* a, const T* b, T* c, size_t m, size_t k, size_t n,
+                       size_t lda, size_t ldb, size_t ldc, bool transposedB) {
+    std::vector<T> scratch(scratchSize(n));
+    multiply(a, b, c, m, k, n, lda, ldb, ldc, transposedB, scratch.data());
+  }
+
+  static void multiply(const T* a, const T* b, T* c, size_t m, size_t k, size_t n,
+                       size_t lda, size_t ldb, size_t ldc, bool transposedB, T* scratch) {
+    T* packedA = scratch;
+    T* packedB = scratch + (mc + mr - 1) / mr * mr * kc;
+    for (size_t jc = 0; jc < n; jc += nc) {
+      size_t cols = std::min(nc, n - jc);
+      for (size_t pc = 0; pc < k; pc += kc) {
+        size_t depth = std::min(kc, k - pc);
+        packB(transposedB ? b + jc * ldb + pc : b + pc * ldb + jc, ldb, depth, cols,
+              packedB, transposedB);
+        for (size_t ic = 0; ic < m; ic += mc) {
+          size_t rows = std::min(mc, m - ic);
+          packA(a + ic * lda + pc, lda, rows, depth, packedA);
+          for (size_t jr = 0; jr < cols; jr += nr) {
+            for (size_t ir = 0; ir < rows; ir += mr) {
+              microKernel(depth, packedA + ir * depth, packedB + jr * depth,
+                          c + (ic + ir) * ldc + jc + jr, ldc,
+                          std::min(mr, rows - ir), std::min(nr, cols - jr));
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+template<typename T>
+const size_t BlockedGemm<T>::mr;
+
+template<typename T>
+const size_t BlockedGemm<T>::nr;
+
+template<typename T>
+const size_t BlockedGemm<T>::kc;
+
+template<typename T>
+const size_t BlockedGemm<T>::mc;
+
+template<typename T>
+const size_t BlockedGemm<T>::nc;
+
+// Field types such as Rational or BigInteger keep the plain triple loop:
+// their multiplications dominate and packing copies would only add work.
+// Kernels that take scratch space need scratchSize(m, k, n) elements of it.
+template<typename T, bool Arithmetic = is_gemm_arithmetic<T>::value>
+struct gemm_kernel {
+  static size_t scratchSize(size_t, size_t, size_t) {
+    return 0;
+  }
+
+  static void multiply(const T* a, const T* b, T* c, size_t m, size_t k, size_t n,
+                       size_t lda, size_t ldb, size_t ldc, bool transposedB) {
+    gemmNaive(a, b, c, m, k, n, lda, ldb, ldc, transposedB);
+  }
+
+  static void multiply(const T* a, const T* b, T* c, size_t m, size_t k, size_t n,
+                       size_t lda, size_t ldb, size_t ldc, bool transposedB, T*) {
+    gemmNaive(a, b, c, m, k, n, lda, ldb, ldc, transposedB);
+  }
+};
+
+template<typename T>
+struct gemm_kernel<T, true> {
+  // Below this many multiply-adds packing does not pay off.
+  static const size_t blockedThreshold = 32 * 32 * 32;
+
+  static size_t scratchSize(size_t m, size_t k, size_t n) {
+    return m * k * n < blockedThreshold ? 0 : BlockedGemm<T>::scratchSize(n);
+  }
+
+  static void multiply(const T* a, const T* b, T* c, size_t m, size_t k, size_t n,
+                       size_t lda, size_t ldb, size_t ldc, bool transposedB) {
+    if (m * k * n < blockedThreshold)
+      gemmNaive(a, b, c, m, k, n, lda, ldb, ldc, transposedB);
+    else
+      BlockedGemm<T>::multiply(a, b, c, m, k, n, lda, ldb, ldc, transposedB);
+  }
+
+  static void multiply(const T* a, const T* b, T* c, size_t m, size_t k, size_t n,
+                       size_t lda, size_t ldb, size_t ldc, bool transposedB, T* scratch) {
+    if (m * k * n < blockedThreshold)
+      gemmNaive(a, b, c, m, k, n, lda, ldb, ldc, transposedB);
+    else
+      BlockedGemm<T>::multiply(a, b, c, m, k, n, lda, ldb, ldc, transposedB, scratch);
+  }
+};
+
+// Residues are multiplied as raw integers below N into 64-bit accumulators,
+// which are reduced modulo N only once every lazyTerms products (18 for
+// N = 1e9 + 7, more than 2^32 for N < 2^16) instead of after every
+// multiply-add. A kc x nc panel of B is unpacked to 32-bit integers and
+// kept in cache while every row of A streams over it. Callers that multiply
+// repeatedly, like SquareProduct, pass in their own scratch space of
+// packedSize(k, n) and accSize(n) elements.
+template<unsigned N>
+struct gemm_kernel<Residue<N>, false> {
+  static const uint64_t lazyTerms =
+      N <= 1 ? ~uint64_t(0) : (~uint64_t(0) - N) / (uint64_t(N - 1) * (N - 1));
+  static const size_t kc = 256;
+  static const size_t nc = 1024;
+
+  static unsigned raw(const Residue<N>& x) {
+    return static_cast<unsigned>(static_cast<int>(x));
+  }
+
+  static size_t packedSize(size_t k, size_t n) {
+    return std::min(kc, k) * std::min(nc, n);
+  }
+
+  static size_t accSize(size_t n) {
+    return std::min(nc, n);
+  }
+
+  static void multiply(const Residue<N>* a, const Residue<N>* b, Residue<N>* c,
+                       size_t m, size_t k, size_t n, size_t lda, size_t ldb, size_t ldc,
+                       bool transposedB) {
+    std::vector<uint32_t> packedB(packedSize(k, n));
+    std::vector<uint64_t> acc(accSize(n));
+    multiply(a, b, c, m, k, n, lda, ldb, ldc, transposedB, packedB.data(), acc.data());
+  }
+
+  static void multiply(const Residue<N>* a, const Residue<N>* b, Residue<N>* c,
+                       size_t m, size_t k, size_t n, size_t lda, size_t ldb, size_t ldc,
+                       bool transposedB, uint32_t* packedB, uint64_t* acc) {
+    for (size_t jc = 0; jc < n; jc += nc) {
+      size_t cols = std::min(nc, n - jc);
+      for (size_t pc = 0; pc < k; pc += kc) {
+        size_t depth = std::min(kc, k - pc);
+        for (size_t p = 0; p < depth; ++p) {
+          for (size_t j = 0; j < cols; ++j) {
+            packedB[p * cols + j] = raw(transposedB ? b[(jc + j) * ldb + pc + p]
+                                                    : b[(pc + p) * ldb + jc + j]);
+          }
+        }
+        for (size_t i = 0; i < m; ++i) {
+          Residue<N>* row = c + i * ldc + jc;
+          for (size_t j = 0; j < cols; ++j) {
+            acc[j] = raw(row[j]);
+          }
+          uint64_t terms = 0;
+          for (size_t p = 0; p < depth; ++p) {
+            uint64_t x = raw(a[i * lda + pc + p]);
+            if (x == 0) {
+              continue;
+            }
+            if (terms == lazyTerms) {
+              for (size_t j = 0; j < cols; ++j) {
+                acc[j] %= N;
+              }
+              terms = 0;
+            }
+            const uint32_t* y = packedB + p * cols;
+            for (size_t j = 0; j < cols; ++j) {
+              acc[j] += x * y[j];
+            }
+            ++terms;
+          }
+          for (size_t j = 0; j < cols; ++j) {
+            row[j] = Residue<N>(static_cast<int>(acc[j] % N));
+          }
+        }
+      }
+    }
+  }
+};
+
+template<unsigned N>
+const uint64_t gemm_kernel<Residue<N>, false>::lazyTerms;
+
+template<unsigned N>
+const size_t gemm_kernel<Residue<N>, false>::kc;
+
+template<unsigned N>
+const size_t gemm_kernel<Residue<N>, false>::nc;
+
+template<typename T>
+void gemm(const T* a, const T* b, T* c, size_t m, size_t k, size_t n,
+          size_t lda, size_t ldb, size_t ldc, bool transposedB = false) {
+  gemm_kernel<T>::multiply(a, b, c, m, k, n, lda, ldb, ldc, transposedB);
+}
+
+template<typename T>
+void gemm(const T* a, const T* b, T* c, size_t m, size_t k, size_t n) {
+  gemm(a, b, c, m, k, n, k, n, n);
+}
+
+// Output tiling for parallelGemm. Arithmetic types use large tiles that
+// keep the blocked kernel efficient; expensive field types use small tiles,
+// since even a 16 x 16 x 16 product of Rational is worth a task.
+template<typename T, bool Arithmetic = is_gemm_arithmetic<T>::value>
+struct gemm_tiling {
+  static const size_t serialThreshold = 16 * 16 * 16;
+  static const size_t tileRows = 16;
+  static const size_t tileCols = 16;
+};
+
+template<typename T>
+struct gemm_tiling<T, true> {
+  static const size_t serialThreshold = 128 * 128 * 128;
+  static const size_t tileRows = 96;
+  static const size_t tileCols = 512;
+};
+
+template<unsigned N>
+struct gemm_tiling<Residue<N>, false> {
+  static const size_t serialThreshold = 128 * 128 * 128;
+  static const size_t tileRows = 96;
+  static const size_t tileCols = 512;
+};
+
+// Splits C into tiles and multiplies them on the pool, falling back to the
+// serial kernel for small products or a pool of at most one thread.
+template<typename T>
+void parallelGemm(const T* a, const T* b, T* c, size_t m, size_t k, size_t n,
+                  size_t lda, size_t ldb, size_t ldc, ThreadPool& pool,
+                  bool transposedB = false) {
+  typedef gemm_tiling<T> tiling;
+  if (pool.size() <= 1 || m * k * n < tiling::serialThreshold) {
+    gemm(a, b, c, m, k, n, lda, ldb, ldc, transposedB);
+    return;
+  }
+  size_t rowTiles = (m + tiling::tileRows - 1) / tiling::tileRows;
+  size_t colTiles = (n + tiling::tileCols - 1) / tiling::tileCols;
+  pool.parallelFor(rowTiles * colTiles, [&](size_t tile) {
+    size_t i = tile / colTiles * tiling::tileRows;
+    size_t j = tile % colTiles * tiling::tileCols;
+    size_t rows = m - i < tiling::tileRows ? m - i : tiling::tileRows;
+    size_t cols = n - j < tiling::tileCols ? n - j : tiling::tileCols;
+    gemm(a + i * lda, transposedB ? b + j * ldb : b + j, c + i * ldc + j, rows, k, cols,
+         lda, ldb, ldc, transposedB);
+  });
+}
+
+template<typename T>
+void parallelGemm(const T* a, const T* b, T* c, size_t m, size_t k, size_t n) {
+  parallelGemm(a, b, c, m, k, n, k, n, n, ThreadPool::global());
+}
+
+// Strassen-Winograd recursion for square products over types whose
+// multiplication is far more expensive than addition: 7 half-size products
+// and 15 block additions per level instead of 8 products. Recursion stops at
+// strassen_cutoff<T>::value, which can be specialised per type.
+template<typename T>
+struct use_strassen {
+  static const bool value = false;
+};
+
+template<>
+struct use_strassen<BigInteger> {
+  static const bool value = true;
+};
+
+template<>
+struct use_strassen<Rational> {
+  static const bool value = true;
+};
+
+template<typename T>
+struct strassen_cutoff {
+  static const size_t value = 16;
+};
+
+// z = x + y and z = x - y on h x h blocks; z is contiguous.
+template<typename T>
+void addBlocks(const T* x, size_t ldx, const T* y, size_t ldy, T* z, size_t h) {
+  for (size_t i = 0; i < h; ++i) {
+    for (size_t j = 0; j < h; ++j) {
+      z[i * h + j] = x[i * ldx + j] + y[i * ldy + j];
+    }
+  }
+}
+
+template<typename T>
+void subtractBlocks(const T* x, size_t ldx, const T* y, size_t ldy, T* z, size_t h) {
+  for (size_t i = 0; i < h; ++i) {
+    for (size_t j = 0; j < h; ++j) {
+      z[i * h + j] = x[i * ldx + j] - y[i * ldy + j];
+    }
+  }
+}
+
+// Elements of scratch space strassenWinograd needs for n x n operands
+// when tasks products already run on pool.
+template<typename T>
+size_t strassenScratchSize(size_t n, const ThreadPool& pool, size_t tasks) {
+  if (n <= strassen_cutoff<T>::value || n < 2) {
+    return 0;
+  }
+  size_t h = n / 2;
+  if (tasks < pool.size()) {
+    return 15 * h * h + 7 * strassenScratchSize<T>(h, pool, tasks * 7);
+  }
+  return 6 * h * h + strassenScratchSize<T>(h, pool, tasks);
+}
+
+template<typename T>
+void strassenWinograd(const T* a, const T* b, T* c, size_t n,
+                      size_t lda, size_t ldb, size_t ldc, ThreadPool& pool, size_t tasks,
+                      T* scratch);
+
+// One level of the recursion with the 7 products as tasks on the pool. All
+// operand sums are formed up front, so the products are independent, at
+// the cost of 15 instead of 6 half-size temporaries; each task gets its own
+// part of the scratch space. tasks is the number of products running at
+// this level, including this one.
+template<typename T>
+void strassenWinogradTasks(const T* a, const T* b, T* c, size_t h,
+                           size_t lda, size_t ldb, size_t ldc, ThreadPool& pool,
+                           size_t tasks, T* scratch) {
+  const T* a11 = a;
+  const T* a12 = a + h;
+  const T* a21 = a + h * lda;
+  const T* a22 = a + h * lda + h;
+  const T* b11 = b;
+  const T* b12 = b + h;
+  const T* b21 = b + h * ldb;
+  const T* b22 = b + h * ldb + h;
+
+  size_t size = h * h;
+  size_t childScratch = strassenScratchSize<T>(h, pool, tasks * 7);
+  T* s1 = scratch;
+  T* s2 = s1 + size;
+  T* s3 = s2 + size;
+  T* s4 = s3 + size;
+  T* t1 = s4 + size;
+  T* t2 = t1 + size;
+  T* t3 = t2 + size;
+  T* t4 = t3 + size;
+  T* p = t4 + size;
+  std::fill(p, p + 7 * size, T(0));
+  addBlocks(a21, lda, a22, lda, s1, h);
+  subtractBlocks(s1, h, a11, lda, s2, h);
+  subtractBlocks(a11, lda, a21, lda, s3, h);
+  subtractBlocks(a12, lda, s2, h, s4, h);
+  subtractBlocks(b12, ldb, b11, ldb, t1, h);
+  subtractBlocks(b22, ldb, t1, h, t2, h);
+  subtractBlocks(b22, ldb, b12, ldb, t3, h);
+  subtractBlocks(t2, h, b21, ldb, t4, h);
+  // P1 = A11 B11, P2 = A12 B21, P3 = S4 B22, P4 = A22 T4, P5 = S1 T1,
+  // P6 = S2 T2, P7 = S3 T3.
+  const T* lhs[7] = {a11, a12, s4, a22, s1, s2, s3};
+  const size_t ldl[7] = {lda, lda, h, lda, h, h, h};
+  const T* rhs[7] = {b11, b21, b22, t4, t1, t2, t3};
+  const size_t ldr[7] = {ldb, ldb, ldb, h, h, h, h};
+  T* children = p + 7 * size;
+  pool.parallelFor(7, [&](size_t i) {
+    strassenWinograd(lhs[i], rhs[i], p + i * size, h, ldl[i], ldr[i], h, pool, tasks * 7,
+                     children + i * childScratch);
+  });
+
+  const T* p1 = p;
+  const T* p2 = p1 + size;
+  const T* p3 = p2 + size;
+  const T* p4 = p3 + size;
+  const T* p5 = p4 + size;
+  const T* p6 = p5 + size;
+  const T* p7 = p6 + size;
+  for (size_t i = 0; i < h; ++i) {
+    for (size_t j = 0; j < h; ++j) {
+      size_t x = i * h + j;
+      T u2 = p1[x] + p6[x];
+      T u3 = u2 + p7[x];
+      c[i * ldc + j] += p1[x] + p2[x];
+      c[i * ldc + h + j] += u2 + p5[x] + p3[x];
+      c[(h + i) * ldc + j] += u3 - p4[x];
+      c[(h + i) * ldc + h + j] += u3 + p5[x];
+    }
+  }
+}
+
+// C += A * B for n x n operands, with strassenScratchSize(n, pool, tasks)
+// elements of scratch. While fewer than pool.size() products run
+// concurrently, a level hands its 7 products to the pool; below that the
+// recursion and the leaves run serially inside their task.
+template<typename T>
+void strassenWinograd(const T* a, const T* b, T* c, size_t n,
+                      size_t lda, size_t ldb, size_t ldc, ThreadPool& pool, size_t tasks,
+                      T* scratch) {
+  if (n <= strassen_cutoff<T>::value || n < 2) {
+    gemm(a, b, c, n, n, n, lda, ldb, ldc);
+    return;
+  }
+  size_t h = n / 2;
+  size_t even = 2 * h;
+  if (even != n) {
+    // Odd n: recurse on the leading even x even part and add the
+    // contributions of the last row and column of the operands directly.
+    gemm(a + even, b + even * ldb, c, even, 1, even, lda, ldb, ldc);
+    gemm(a, b + even, c + even, even, n, 1, lda, ldb, ldc);
+    gemm(a + even * lda, b, c + even * ldc, 1, n, n, lda, ldb, ldc);
+  }
+  if (tasks < pool.size()) {
+    strassenWinogradTasks(a, b, c, h, lda, ldb, ldc, pool, tasks, scratch);
+    return;
+  }
+  const T* a11 = a;
+  const T* a12 = a + h;
+  const T* a21 = a + h * lda;
+  const T* a22 = a + h * lda + h;
+  const T* b11 = b;
+  const T* b12 = b + h;
+  const T* b21 = b + h * ldb;
+  const T* b22 = b + h * ldb + h;
+  T* c11 = c;
+  T* c12 = c + h;
+  T* c21 = c + h * ldc;
+  T* c22 = c + h * ldc + h;
+
+  size_t size = h * h;
+  T* s = scratch;
+  T* t = s + size;
+  T* p1 = t + size;
+  T* p5 = p1 + size;
+  T* u2 = p5 + size;
+  T* m = u2 + size;
+  T* child = m + size;
+  std::fill(p1, p1 + 4 * size, T(0));
+  strassenWinograd(a11, b11, p1, h, lda, ldb, h, pool, tasks, child);
+  strassenWinograd(a12, b21, m, h, lda, ldb, h, pool, tasks, child);
+  for (size_t i = 0; i < h; ++i) {
+    for (size_t j = 0; j < h; ++j) {
+      c11[i * ldc + j] += p1[i * h + j] + m[i * h + j];
+    }
+  }
+  addBlocks(a21, lda, a22, lda, s, h);  // S1 = A21 + A22
+  subtractBlocks(b12, ldb, b11, ldb, t, h);  // T1 = B12 - B11
+  strassenWinograd(s, t, p5, h, h, h, h, pool, tasks, child);
+  subtractBlocks(s, h, a11, lda, s, h);  // S2 = S1 - A11
+  subtractBlocks(b22, ldb, t, h, t, h);  // T2 = B22 - T1
+  strassenWinograd(s, t, u2, h, h, h, h, pool, tasks, child);
+  for (size_t i = 0; i < size; ++i) {
+    u2[i] += p1[i];  // U2 = P1 + P6
+  }
+  subtractBlocks(a12, lda, s, h, s, h);  // S4 = A12 - S2
+  std::fill(m, m + size, T(0));
+  strassenWinograd(s, b22, m, h, h, ldb, h, pool, tasks, child);
+  for (size_t i = 0; i < h; ++i) {
+    for (size_t j = 0; j < h; ++j) {
+      c12[i * ldc + j] += u2[i * h + j] + p5[i * h + j] + m[i * h + j];
+    }
+  }
+  subtractBlocks(t, h, b21, ldb, t, h);  // T4 = T2 - B21
+  std::fill(m, m + size, T(0));
+  strassenWinograd(a22, t, m, h, lda, h, h, pool, tasks, child);
+  subtractBlocks(a11, lda, a21, lda, s, h);  // S3 = A11 - A21
+  subtractBlocks(b22, ldb, b12, ldb, t, h);  // T3 = B22 - B12
+  std::fill(p1, p1 + size, T(0));
+  strassenWinograd(s, t, p1, h, h, h, h, pool, tasks, child);
+  for (size_t i = 0; i < h; ++i) {
+    for (size_t j = 0; j < h; ++j) {
+      T u3 = u2[i * h + j] + p1[i * h + j];  // U3 = U2 + P7
+      c21[i * ldc + j] += u3 - m[i * h + j];
+      c22[i * ldc + j] += u3 + p5[i * h + j];
+    }
+  }
+}
+
+// C += A * B for n x n row-major operands.
+template<typename T, bool Strassen = use_strassen<T>::value>
+struct square_gemm {
+  static void multiply(const T* a, const T* b, T* c, size_t n) {
+    parallelGemm(a, b, c, n, n, n);
+  }
+};
+
+template<typename T>
+struct square_gemm<T, true> {
+  static void multiply(const T* a, const T* b, T* c, size_t n) {
+    ThreadPool& pool = ThreadPool::global();
+    std::vector<T> scratch(strassenScratchSize<T>(n, pool, 1));
+    strassenWinograd(a, b, c, n, n, n, n, pool, 1, scratch.data());
+  }
+};
+
+// Repeated products of n x n matrices, as in Matrix::pow: c = a * b, where
+// c does not alias a or b. Scratch space is allocated once, in the
+// constructor: the temporaries of Strassen-Winograd, or the packed panels
+// of the kernel when the product runs serially. Products split into tiles
+// over the pool allocate per tile, which is small next to the product.
+// The global pool must not be resized while a SquareProduct exists.
+template<typename T>
+class SquareProduct {
+  typedef std::integral_constant<bool, use_strassen<T>::value> Strassen;
+
+  size_t n_;
+  bool serial_;
+  std::vector<T> scratch_;
+
+  size_t scratchSize(std::true_type) const {
+    return strassenScratchSize<T>(n_, ThreadPool::global(), 1);
+  }
+
+  size_t scratchSize(std::false_type) const {
+    return serial_ ? gemm_kernel<T>::scratchSize(n_, n_, n_) : 0;
+  }
+
+  void multiply(const T* a, const T* b, T* c, std::true_type) {
+    strassenWinograd(a, b, c, n_, n_, n_, n_, ThreadPool::global(), 1, scratch_.data());
+  }
+
+  void multiply(const T* a, const T* b, T* c, std::false_type) {
+    if (serial_) {
+      gemm_kernel<T>::multiply(a, b, c, n_, n_, n_, n_, n_, n_, false, scratch_.data());
+    } else {
+      parallelGemm(a, b, c, n_, n_, n_);
+    }
+  }
+
+ public:
+  explicit SquareProduct(size_t n)
+      : n_(n),
+        serial_(ThreadPool::global().size() <= 1 ||
+                n * n * n < gemm_tiling<T>::serialThreshold) {
+    scratch_.resize(scratchSize(Strassen()));
+  }
+
+  void multiply(const T* a, const T* b, T* c) {
+    std::fill(c, c + n_ * n_, T(0));
+    multiply(a, b, c, Strassen());
+  }
+};
+
+// Products small enough to run serially reuse the packing and accumulator
+// buffers of the Residue kernel; larger ones are split over the pool, where
+// one allocation per product does not matter.
+template<unsigned N>
+class SquareProduct<Residue<N>> {
+  typedef gemm_kernel<Residue<N>, false> kernel;
+
+  size_t n_;
+  std::vector<uint32_t> packedB_;
+  std::vector<uint64_t> acc_;
+
+  bool serial() const {
+    return ThreadPool::global().size() <= 1 ||
+           n_ * n_ * n_ < gemm_tiling<Residue<N>>::serialThreshold;
+  }
+
+ public:
+  explicit SquareProduct(size_t n) : n_(n) {
+    if (serial()) {
+      packedB_.resize(kernel::packedSize(n, n));
+      acc_.resize(kernel::accSize(n));
+    }
+  }
+
+  void multiply(const Residue<N>* a, const Residue<N>* b, Residue<N>* c) {
+    std::fill(c, c + n_ * n_, Residue<N>(0));
+    if (packedB_.empty()) {
+      square_gemm<Residue<N>>::multiply(a, b, c, n_);
+    } else {
+      kernel::multiply(a, b, c, n_, n_, n_, n_, n_, n_, false, packedB_.data(), acc_.data());
+    }
+  }
+};
@@ -1,218 +1,541 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "gauss.hpp"
+#include "gemm.hpp"
+#include "matrix_expr.hpp"
+#include "transpose.hpp"
+
+// Heap block of elements aligned to a cache line, shared by the storage of
+// large fixed-size matrices and by DynamicMatrix.
+template <typename T>
+class AlignedBuffer {
+ private:
+  static const size_t alignment = 64;
+  size_t size_ = 0;
+  void* block_ = nullptr;
+  T* a_ = nullptr;
+
+  void allocate(size_t size) {
+    size_ = size;
+    block_ = ::operator new(size * sizeof(T) + alignment);
+    a_ = reinterpret_cast<T*>(
+        (reinterpret_cast<uintptr_t>(block_) + alignment - 1) & ~(alignment - 1));
+  }
+  void release() {
+    if (block_ == nullptr) {
+      return;
+    }
+    for (size_t i = 0; i < size_; ++i) {
+      a_[i].~T();
+    }
+    ::operator delete(block_);
+    size_ = 0;
+    block_ = nullptr;
+    a_ = nullptr;
+  }
+
+ public:
+  AlignedBuffer() = default;
+  explicit AlignedBuffer(size_t size) {
+    allocate(size);
+    for (size_t i = 0; i < size_; ++i) {
+      new (a_ + i) T;
+    }
+  }
+  AlignedBuffer(const AlignedBuffer& buffer) {
+    allocate(buffer.size_);
+    for (size_t i = 0; i < size_; ++i) {
+      new (a_ + i) T(buffer.a_[i]);
+    }
+  }
+  // Leaves the source empty.
+  AlignedBuffer(AlignedBuffer&& buffer) noexcept
+      : size_(buffer.size_), block_(buffer.block_), a_(buffer.a_) {
+    buffer.size_ = 0;
+    buffer.block_ = nullptr;
+    buffer.a_ = nullptr;
+  }
+  AlignedBuffer& operator=(const AlignedBuffer& buffer) {
+    if (this == &buffer) {
+      return *this;
+    }
+    if (size_ != buffer.size_) {
+      AlignedBuffer temp(buffer);
+      return *this = std::move(temp);
+    }
+    std::copy(buffer.a_, buffer.a_ + size_, a_);
+    return *this;
+  }
+  AlignedBuffer& operator=(AlignedBuffer&& buffer) noexcept {
+    std::swap(size_, buffer.size_);
+    std::swap(block_, buffer.block_);
+    std::swap(a_, buffer.a_);
+    return *this;
+  }
+  ~AlignedBuffer() { release(); }
+  size_t size() const { return size_; }
+  T* data() { return a_; }
+  const T* data() const { return a_; }
+};
+
+// Matrices up to this many bytes keep their elements inline, larger ones in
+// an aligned heap block, so that big matrices neither overflow the stack nor
+// get deep-copied when returned or assigned from temporaries.
+const size_t matrixInlineBytes = 4096;
+
+template <typename T, size_t Size,
+          bool Inline = (Size * sizeof(T) <= matrixInlineBytes)>
+class MatrixStorage {
+ private:
+  T a_[Size];
+
+ public:
+  T* data() { return a_; }
+  const T* data() const { return a_; }
+};
+
+// Moving a heap storage hands over its block without allocating and leaves
+// the source empty. An empty storage still behaves as a zero matrix: reads
+// see a block of zeros shared by all storages of the type, and the first
+// write allocates its own. Reads go through elems_ and need no check.
+template <typename T, size_t Size>
+class MatrixStorage<T, Size, false> {
+ private:
+  AlignedBuffer<T> buffer_;
+  const T* elems_;  // buffer_.data(), or zeros() when buffer_ is empty
+
+  static AlignedBuffer<T> zeroBuffer() {
+    AlignedBuffer<T> buffer(Size);
+    std::fill(buffer.data(), buffer.data() + Size, T(0));
+    return buffer;
+  }
+  // Created by the first storage constructed, so moves never allocate it.
+  static const T* zeros() {
+    static const AlignedBuffer<T> buffer = zeroBuffer();
+    return buffer.data();
+  }
+  T* allocate() {
+    buffer_ = zeroBuffer();
+    elems_ = buffer_.data();
+    return buffer_.data();
+  }
+
+ public:
+  MatrixStorage() : buffer_(Size), elems_(buffer_.data()) { zeros(); }
+  MatrixStorage(const MatrixStorage& storage)
+      : buffer_(Size), elems_(buffer_.data()) {
+    zeros();
+    std::copy(storage.elems_, storage.elems_ + Size, buffer_.data());
+  }
+  MatrixStorage(MatrixStorage&& storage) noexcept
+      : buffer_(std::move(storage.buffer_)), elems_(storage.elems_) {
+    storage.elems_ = zeros();
+  }
+  MatrixStorage& operator=(const MatrixStorage& storage) {
+    std::copy(storage.elems_, storage.elems_ + Size, data());
+    return *this;
+  }
+  MatrixStorage& operator=(MatrixStorage&& storage) noexcept {
+    std::swap(buffer_, storage.buffer_);
+    std::swap(elems_, storage.elems_);
+    return *this;
+  }
+  T* data() { return buffer_.data() != nullptr ? buffer_.data() : allocate(); }
+  const T* data() const { return elems_; }
+};
 
 template <size_t H, size_t W, typename T = int64_t>
-class Matrix {
+class Matrix : public MatrixExpr<Matrix<H, W, T>> {
  private:
-  T a_[H][W];
+  MatrixStorage<T, H * W> a_;
 
  public:
   typedef Matrix<std::max<size_t>(H - 1, 1), std::max<size_t>(W - 1, 1), T>
       MatrixMinor;
+  static const size_t rows = H;
+  static const size_t cols = W;
+  static const bool elementwise = true;
+  typedef T value_type;
   Matrix() {
+    T* a = data();
     for (size_t i = 0; i < H; ++i) {
       for (size_t j = 0; j < W; ++j) {
-        a_[i][j] = 0;
+        a[i * W + j] = T(0);
       }
     }
   }
   explicit Matrix(const T& elem) {
+    T* a = data();
     for (size_t idx = 0; idx < H; ++idx) {
       for (size_t jdx = 0; jdx < W; ++jdx) {
-        a_[idx][jdx] = elem;
+        a[idx * W + jdx] = elem;
       }
     }
   }
-  T& operator()(const size_t& idx, const size_t& jdx) { return a_[idx][jdx]; }
+  T& operator()(const size_t& idx, const size_t& jdx) {
+    return a_.data()[idx * W + jdx];
+  }
   const T& operator()(const size_t& idx, const size_t& jdx) const {
-    return a_[idx][jdx];
+    return a_.data()[idx * W + jdx];
   }
+  T* data() { return a_.data(); }
+  const T* data() const { return a_.data(); }
   Matrix(const std::vector<std::vector<T>>& matrix) {
     for (size_t idx = 0; idx < H; ++idx) {
       for (size_t jdx = 0; jdx < W; ++jdx) {
-        a_[idx][jdx] = matrix[idx][jdx];
+        (*this)(idx, jdx) = matrix[idx][jdx];
       }
     }
   }
-  bool operator==(const Matrix& rhs) const {
-    for (size_t idx = 0; idx < H; ++idx) {
-      for (size_t jdx = 0; jdx < W; ++jdx) {
-        if (a_[idx][jdx] != rhs(idx, jdx)) {
-          return false;
-        }
-      }
-    }
-    return true;
-  }
-  bool operator!=(const Matrix& rhs) const { return *this != rhs; }
-  template <size_t W1>
-  friend Matrix<H, W1, T> operator*(const Matrix<H, W, T>& lhs,
-                                    const Matrix<W, W1, T>& rhs) {
-    Matrix<H, W1, T> matr;
+  // Evaluates an expression in one pass. Element-wise expressions are
+  // written straight into *this even if they refer to it; others are
+  // evaluated into a temporary first.
+  template <typename E>
+  Matrix(const MatrixExpr<E>& expr) {
+    static_assert(E::rows == H && E::cols == W, "Matrix dimensions do not match");
+    const E& elems = expr.self();
+    T* a = data();
     for (size_t i = 0; i < H; ++i) {
-      for (size_t k = 0; k < W; ++k) {
-        for (size_t j = 0; j < W1; ++j) {
-          matr(i, j) += lhs(i, k) * rhs(k, j);
-        }
+      for (size_t j = 0; j < W; ++j) {
+        a[i * W + j] = elems(i, j);
       }
     }
-    return matr;
   }
-  friend Matrix operator*(const T& lhs, const Matrix& rhs) {
-    Matrix matr;
+  template <typename E>
+  Matrix& operator=(const MatrixExpr<E>& expr) {
+    if (!E::elementwise) {
+      return *this = Matrix(expr);
+    }
+    static_assert(E::rows == H && E::cols == W, "Matrix dimensions do not match");
+    const E& elems = expr.self();
+    T* a = data();
     for (size_t i = 0; i < H; ++i) {
       for (size_t j = 0; j < W; ++j) {
-        matr(i, j) = lhs * rhs(i, j);
+        a[i * W + j] = elems(i, j);
       }
     }
+    return *this;
+  }
+  Matrix(const MatrixTransposedView<W, H, T>& view) {
+    transpose(view.Transposed().data(), data(), W, H, H, W);
+  }
+  template <size_t W1>
+  friend Matrix<H, W1, T> operator*(const Matrix<H, W, T>& lhs,
+                                    const Matrix<W, W1, T>& rhs) {
+    Matrix<H, W1, T> matr;
+    parallelGemm(lhs.data(), rhs.data(), matr.data(), H, W, W1);
     return matr;
   }
-  friend Matrix operator*(const Matrix& lhs, const T& rhs) { return rhs * lhs; }
   template <size_t W1>
   Matrix& operator*=(const Matrix<W, W1, T>& rhs) {
     return *this = *this * rhs;
   }
-  Matrix& operator*=(const T& rhs) { return *this = *this * rhs; }
-  Matrix operator+() const { return *this; }
-  Matrix operator-() const { return *this * -1; }
-  Matrix& operator+=(const Matrix& rhs) {
+  Matrix& operator*=(const T& rhs) {
+    T* a = data();
     for (size_t i = 0; i < H; ++i) {
       for (size_t j = 0; j < W; ++j) {
-        a_[i][j] += rhs(i, j);
+        a[i * W + j] *= rhs;
       }
     }
     return *this;
   }
-  friend Matrix operator+(const Matrix& lhs, const Matrix& rhs) {
-    return Matrix(lhs) += rhs;
-  }
-  Matrix& operator-=(const Matrix& rhs) { return *this += -rhs; }
-  friend Matrix operator-(const Matrix& lhs, const Matrix& rhs) {
-    return Matrix(lhs) -= rhs;
+  Matrix operator+() const { return *this; }
+  template <typename E>
+  Matrix& operator+=(const MatrixExpr<E>& rhs) {
+    if (!E::elementwise) {
+      return *this += Matrix(rhs);
+    }
+    static_assert(E::rows == H && E::cols == W, "Matrix dimensions do not match");
+    const E& elems = rhs.self();
+    T* a = data();
+    for (size_t i = 0; i < H; ++i) {
+      for (size_t j = 0; j < W; ++j) {
+        a[i * W + j] += elems(i, j);
+      }
+    }
+    return *this;
   }
-  Matrix<W, H, T> Transposed() const {
-    Matrix<W, H, T> matr;
+  template <typename E>
+  Matrix& operator-=(const MatrixExpr<E>& rhs) {
+    if (!E::elementwise) {
+      return *this -= Matrix(rhs);
+    }
+    static_assert(E::rows == H && E::cols == W, "Matrix dimensions do not match");
+    const E& elems = rhs.self();
+    T* a = data();
     for (size_t i = 0; i < H; ++i) {
       for (size_t j = 0; j < W; ++j) {
-        matr(j, i) = a_[i][j];
+        a[i * W + j] -= elems(i, j);
       }
     }
-    return matr;
+    return *this;
   }
+  Matrix& operator=(const MatrixTransposedView<W, H, T>& view) {
+    transpose(view.Transposed().data(), data(), W, H, H, W);
+    return *this;
+  }
+  Matrix<W, H, T> Transposed() const {
+    return Matrix<W, H, T>(TransposedView());
+  }
+  // Zero-copy view of the transpose, so that A * B.TransposedView()
+  // multiplies by the transpose without building it. The view refers to
+  // *this, so it is not available on temporaries.
+  MatrixTransposedView<H, W, T> TransposedView() const & {
+    return MatrixTransposedView<H, W, T>(*this);
+  }
+  MatrixTransposedView<H, W, T> TransposedView() && = delete;
   T Trace() const {
-    T matr = 0;
+    T matr = T(0);
     for (size_t i = 0; i < std::min(W, H); ++i) {
-      matr += a_[i][i];
+      matr += (*this)(i, i);
     }
     return matr;
   }
 };
 
 template <size_t H, typename T>
-class Matrix<H, H, T> {
+class Matrix<H, H, T> : public MatrixExpr<Matrix<H, H, T>> {
  private:
-  T a_[H][H];
+  MatrixStorage<T, H * H> a_;
 
  public:
   typedef Matrix<std::max<size_t>(H - 1, 1), std::max<size_t>(H - 1, 1), T>
       MatrixMinor;
+  static const size_t rows = H;
+  static const size_t cols = H;
+  static const bool elementwise = true;
+  typedef T value_type;
   Matrix() {
+    T* a = data();
     for (size_t i = 0; i < H; ++i) {
       for (size_t j = 0; j < H; ++j) {
-        a_[i][j] = 0;
+        a[i * H + j] = T(0);
       }
     }
   }
   explicit Matrix(const T& elem) {
+    T* a = data();
     for (size_t idx = 0; idx < H; ++idx) {
       for (size_t jdx = 0; jdx < H; ++jdx) {
-        a_[idx][jdx] = elem;
+        a[idx * H + jdx] = elem;
       }
     }
   }
-  T& operator()(const size_t& idx, const size_t& jdx) { return a_[idx][jdx]; }
+  T& operator()(const size_t& idx, const size_t& jdx) {
+    return a_.data()[idx * H + jdx];
+  }
   const T& operator()(const size_t& idx, const size_t& jdx) const {
-    return a_[idx][jdx];
+    return a_.data()[idx * H + jdx];
   }
+  T* data() { return a_.data(); }
+  const T* data() const { return a_.data(); }
   Matrix(const std::vector<std::vector<T>>& matrix) {
     for (size_t idx = 0; idx < H; ++idx) {
       for (size_t jdx = 0; jdx < H; ++jdx) {
-        a_[idx][jdx] = matrix[idx][jdx];
+        (*this)(idx, jdx) = matrix[idx][jdx];
       }
     }
   }
-  bool operator==(const Matrix& rhs) const {
-    for (size_t idx = 0; idx < H; ++idx) {
-      for (size_t jdx = 0; jdx < H; ++jdx) {
-        if (a_[idx][jdx] != rhs(idx, jdx)) {
-          return false;
-        }
+  // Evaluates an expression in one pass. Element-wise expressions are
+  // written straight into *this even if they refer to it; others are
+  // evaluated into a temporary first.
+  template <typename E>
+  Matrix(const MatrixExpr<E>& expr) {
+    static_assert(E::rows == H && E::cols == H, "Matrix dimensions do not match");
+    const E& elems = expr.self();
+    T* a = data();
+    for (size_t i = 0; i < H; ++i) {
+      for (size_t j = 0; j < H; ++j) {
+        a[i * H + j] = elems(i, j);
+      }
+    }
+  }
+  template <typename E>
+  Matrix& operator=(const MatrixExpr<E>& expr) {
+    if (!E::elementwise) {
+      return *this = Matrix(expr);
+    }
+    static_assert(E::rows == H && E::cols == H, "Matrix dimensions do not match");
+    const E& elems = expr.self();
+    T* a = data();
+    for (size_t i = 0; i < H; ++i) {
+      for (size_t j = 0; j < H; ++j) {
+        a[i * H + j] = elems(i, j);
       }
     }
-    return true;
+    return *this;
+  }
+  Matrix(const MatrixTransposedView<H, H, T>& view) {
+    transpose(view.Transposed().data(), data(), H, H, H, H);
   }
-  bool operator!=(const Matrix& rhs) const { return *this != rhs; }
   template <size_t W1>
   friend Matrix<H, W1, T> operator*(const Matrix<H, H, T>& lhs,
                                     const Matrix<H, W1, T>& rhs) {
     Matrix<H, W1, T> matr;
-    for (size_t i = 0; i < H; ++i) {
-      for (size_t k = 0; k < H; ++k) {
-        for (size_t j = 0; j < W1; ++j) {
-          matr(i, j) += lhs(i, k) * rhs(k, j);
-        }
-      }
+    if (W1 == H) {
+      square_gemm<T>::multiply(lhs.data(), rhs.data(), matr.data(), H);
+    } else {
+      parallelGemm(lhs.data(), rhs.data(), matr.data(), H, H, W1);
     }
     return matr;
   }
-  friend Matrix operator*(const T& lhs, const Matrix& rhs) {
-    Matrix matr;
+  template <size_t W1>
+  Matrix& operator*=(const Matrix<H, W1, T>& rhs) {
+    return *this = *this * rhs;
+  }
+  Matrix& operator*=(const T& rhs) {
+    T* a = data();
     for (size_t i = 0; i < H; ++i) {
       for (size_t j = 0; j < H; ++j) {
-        matr(i, j) = lhs * rhs(i, j);
+        a[i * H + j] *= rhs;
       }
     }
-    return matr;
-  }
-  friend Matrix operator*(const Matrix& lhs, const T& rhs) { return rhs * lhs; }
-  template <size_t W1>
-  Matrix& operator*=(const Matrix<H, W1, T>& rhs) {
-    return *this = *this * rhs;
+    return *this;
   }
-  Matrix& operator*=(const T& rhs) { return *this = *this * rhs; }
   Matrix operator+() const { return *this; }
-  Matrix operator-() const { return *this * -1; }
-  Matrix& operator+=(const Matrix& rhs) {
+  template <typename E>
+  Matrix& operator+=(const MatrixExpr<E>& rhs) {
+    if (!E::elementwise) {
+      return *this += Matrix(rhs);
+    }
+    static_assert(E::rows == H && E::cols == H, "Matrix dimensions do not match");
+    const E& elems = rhs.self();
+    T* a = data();
     for (size_t i = 0; i < H; ++i) {
       for (size_t j = 0; j < H; ++j) {
-        a_[i][j] += rhs(i, j);
+        a[i * H + j] += elems(i, j);
       }
     }
     return *this;
   }
-  friend Matrix operator+(const Matrix& lhs, const Matrix& rhs) {
-    return Matrix(lhs) += rhs;
-  }
-  Matrix& operator-=(const Matrix& rhs) { return *this += -rhs; }
-  friend Matrix operator-(const Matrix& lhs, const Matrix& rhs) {
-    return Matrix(lhs) -= rhs;
-  }
-  Matrix<H, H, T> Transposed() const {
-    Matrix<H, H, T> matr;
+  template <typename E>
+  Matrix& operator-=(const MatrixExpr<E>& rhs) {
+    if (!E::elementwise) {
+      return *this -= Matrix(rhs);
+    }
+    static_assert(E::rows == H && E::cols == H, "Matrix dimensions do not match");
+    const E& elems = rhs.self();
+    T* a = data();
     for (size_t i = 0; i < H; ++i) {
       for (size_t j = 0; j < H; ++j) {
-        matr(j, i) = a_[i][j];
+        a[i * H + j] -= elems(i, j);
       }
     }
-    return matr;
+    return *this;
+  }
+  Matrix& operator=(const MatrixTransposedView<H, H, T>& view) {
+    if (&view.Transposed() == this) {
+      Transpose();
+    } else {
+      transpose(view.Transposed().data(), data(), H, H, H, H);
+    }
+    return *this;
+  }
+  Matrix Transposed() const & {
+    return Matrix(TransposedView());
+  }
+  // A temporary is transposed in place and moved out.
+  Matrix Transposed() && {
+    Transpose();
+    return std::move(*this);
+  }
+  // Zero-copy view of the transpose, so that A * B.TransposedView()
+  // multiplies by the transpose without building it and A = A.TransposedView()
+  // transposes in place. The view refers to *this, so it is not available on
+  // temporaries.
+  MatrixTransposedView<H, H, T> TransposedView() const & {
+    return MatrixTransposedView<H, H, T>(*this);
   }
+  MatrixTransposedView<H, H, T> TransposedView() && = delete;
+  void Transpose() { transposeInPlace(data(), H, H); }
   T Trace() const {
-    T matr = 0;
+    T matr = T(0);
     for (size_t i = 0; i < H; ++i) {
-      matr += a_[i][i];
+      matr += (*this)(i, i);
     }
     return matr;
   }
-};
\ No newline at end of file
+  // Determinant, rank and inverse by elimination in O(H^3): Bareiss for
+  // integers, BigInteger and Rational, pivoted Gaussian elimination
+  // otherwise.
+  T Det() const {
+    Matrix matr(*this);
+    T det;
+    rowEchelon(matr.data(), H, H, static_cast<T*>(nullptr), 0, det);
+    return det;
+  }
+  size_t Rank() const {
+    Matrix matr(*this);
+    T det;
+    return rowEchelon(matr.data(), H, H, static_cast<T*>(nullptr), 0, det);
+  }
+  // Solution x of (*this) * x = b; throws std::domain_error if singular.
+  template <size_t W1>
+  Matrix<H, W1, T> Solve(const Matrix<H, W1, T>& b) const {
+    static_assert(!std::is_same<T, BigInteger>::value && !std::is_integral<T>::value,
+                  "Solve needs division in a field, use Rational");
+    Matrix matr(*this);
+    Matrix<H, W1, T> x(b);
+    T det;
+    if (rowEchelon(matr.data(), H, H, x.data(), W1, det) < H) {
+      throw std::domain_error("Matrix is singular");
+    }
+    backSubstitution(matr.data(), H, x.data(), W1);
+    return x;
+  }
+  // (*this)^k by left-to-right binary exponentiation, O(H^3 log k): the
+  // result starts as *this at the top bit of k, is squared for every lower
+  // bit and multiplied by *this where the bit is set. The result and one
+  // scratch matrix are allocated once and swapped by pointer between steps.
+  Matrix pow(uint64_t k) const {
+    if (k == 0) {
+      Matrix identity;
+      for (size_t i = 0; i < H; ++i) {
+        identity(i, i) = T(1);
+      }
+      return identity;
+    }
+    Matrix first(*this);
+    Matrix second;
+    Matrix* result = &first;
+    Matrix* scratch = &second;
+    SquareProduct<T> product(H);
+    int bit = 63;
+    while (((k >> bit) & 1) == 0) {
+      --bit;
+    }
+    for (--bit; bit >= 0; --bit) {
+      product.multiply(result->data(), result->data(), scratch->data());
+      std::swap(result, scratch);
+      if ((k >> bit) & 1) {
+        product.multiply(result->data(), data(), scratch->data());
+        std::swap(result, scratch);
+      }
+    }
+    return std::move(*result);
+  }
+  Matrix Inverted() const {
+    Matrix identity;
+    for (size_t i = 0; i < H; ++i) {
+      identity(i, i) = T(1);
+    }
+    return Solve(identity);
+  }
+};
+
+template <size_t H, size_t K, size_t W1, typename T>
+Matrix<H, W1, T> operator*(const Matrix<H, K, T>& lhs,
+                           const MatrixTransposedView<W1, K, T>& rhs) {
+  Matrix<H, W1, T> matr;
+  parallelGemm(lhs.data(), rhs.Transposed().data(), matr.data(), H, K, W1, K, K, W1,
+               ThreadPool::global(), true);
+  return matr;
+}
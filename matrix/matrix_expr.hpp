@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Lazy element-wise matrix arithmetic. A + B - C * 2 builds a small tree of
+// expression nodes and is evaluated in a single pass when it is assigned to
+// (or used to construct) a Matrix, without intermediate matrices. Products
+// of two matrices stay eager and go through the gemm kernels.
+//
+// Every expression type E provides E::rows, E::cols, E::value_type,
+// value_type operator()(size_t, size_t) const and E::elementwise, which is
+// false when element (i, j) may read operand elements at other positions.
+// Assigning such an expression to a matrix it refers to goes through a
+// temporary.
+
+template <size_t H, size_t W, typename T>
+class Matrix;
+
+template <typename E>
+class MatrixExpr {
+ public:
+  const E& self() const { return static_cast<const E&>(*this); }
+
+  auto Transposed() const {
+    return Matrix<E::rows, E::cols, typename E::value_type>(self()).Transposed();
+  }
+  auto Trace() const {
+    return Matrix<E::rows, E::cols, typename E::value_type>(self()).Trace();
+  }
+};
+
+template <typename E>
+struct is_matrix_expr {
+  static const bool value = std::is_base_of<MatrixExpr<E>, E>::value;
+};
+
+template <typename E>
+struct is_matrix {
+  static const bool value = false;
+};
+
+template <size_t H, size_t W, typename T>
+struct is_matrix<Matrix<H, W, T>> {
+  static const bool value = true;
+};
+
+// Lvalue operands are referenced, temporaries are moved into the node, so
+// `auto e = A + B * C;` does not dangle.
+template <typename E>
+using matrix_operand = typename std::conditional<
+    std::is_lvalue_reference<E>::value, const typename std::decay<E>::type&,
+    typename std::decay<E>::type>::type;
+
+template <typename L, typename R>
+using enable_if_matrix_exprs = typename std::enable_if<
+    is_matrix_expr<typename std::decay<L>::type>::value &&
+    is_matrix_expr<typename std::decay<R>::type>::value>::type;
+
+struct matrix_plus {
+  template <typename T>
+  static T apply(const T& lhs, const T& rhs) { return lhs + rhs; }
+};
+
+struct matrix_minus {
+  template <typename T>
+  static T apply(const T& lhs, const T& rhs) { return lhs - rhs; }
+};
+
+template <typename L, typename R, typename Op>
+class MatrixBinaryExpr : public MatrixExpr<MatrixBinaryExpr<L, R, Op>> {
+ private:
+  typedef typename std::decay<L>::type Left;
+  typedef typename std::decay<R>::type Right;
+  L lhs_;
+  R rhs_;
+
+ public:
+  static_assert(Left::rows == Right::rows && Left::cols == Right::cols,
+                "Matrix dimensions do not match");
+  static_assert(std::is_same<typename Left::value_type,
+                             typename Right::value_type>::value,
+                "Matrix element types do not match");
+  static const size_t rows = Left::rows;
+  static const size_t cols = Left::cols;
+  static const bool elementwise = Left::elementwise && Right::elementwise;
+  typedef typename Left::value_type value_type;
+
+  template <typename LArg, typename RArg>
+  MatrixBinaryExpr(LArg&& lhs, RArg&& rhs)
+      : lhs_(std::forward<LArg>(lhs)), rhs_(std::forward<RArg>(rhs)) {}
+  value_type operator()(const size_t& idx, const size_t& jdx) const {
+    return Op::apply(lhs_(idx, jdx), rhs_(idx, jdx));
+  }
+};
+
+template <typename E>
+class MatrixScaledExpr : public MatrixExpr<MatrixScaledExpr<E>> {
+ private:
+  typedef typename std::decay<E>::type Inner;
+  E expr_;
+  typename Inner::value_type scalar_;
+
+ public:
+  static const size_t rows = Inner::rows;
+  static const size_t cols = Inner::cols;
+  static const bool elementwise = Inner::elementwise;
+  typedef typename Inner::value_type value_type;
+
+  template <typename Arg>
+  MatrixScaledExpr(Arg&& expr, const value_type& scalar)
+      : expr_(std::forward<Arg>(expr)), scalar_(scalar) {}
+  value_type operator()(const size_t& idx, const size_t& jdx) const {
+    return scalar_ * expr_(idx, jdx);
+  }
+};
+
+template <typename E>
+class MatrixNegatedExpr : public MatrixExpr<MatrixNegatedExpr<E>> {
+ private:
+  typedef typename std::decay<E>::type Inner;
+  E expr_;
+
+ public:
+  static const size_t rows = Inner::rows;
+  static const size_t cols = Inner::cols;
+  static const bool elementwise = Inner::elementwise;
+  typedef typename Inner::value_type value_type;
+
+  template <typename Arg>
+  explicit MatrixNegatedExpr(Arg&& expr) : expr_(std::forward<Arg>(expr)) {}
+  value_type operator()(const size_t& idx, const size_t& jdx) const {
+    return value_type(0) - expr_(idx, jdx);
+  }
+};
+
+// Zero-copy transpose of a Matrix<H, W, T>, which must outlive the view.
+// Matrix * view multiplies by the transpose without materialising it.
+template <size_t H, size_t W, typename T>
+class MatrixTransposedView : public MatrixExpr<MatrixTransposedView<H, W, T>> {
+ private:
+  const Matrix<H, W, T>& matrix_;
+
+ public:
+  static const size_t rows = W;
+  static const size_t cols = H;
+  static const bool elementwise = false;
+  typedef T value_type;
+
+  explicit MatrixTransposedView(const Matrix<H, W, T>& matrix) : matrix_(matrix) {}
+  const T& operator()(const size_t& idx, const size_t& jdx) const {
+    return matrix_(jdx, idx);
+  }
+  const Matrix<H, W, T>& Transposed() const { return matrix_; }
+};
+
+template <typename L, typename R, typename = enable_if_matrix_exprs<L, R>>
+MatrixBinaryExpr<matrix_operand<L>, matrix_operand<R>, matrix_plus>
+operator+(L&& lhs, R&& rhs) {
+  return MatrixBinaryExpr<matrix_operand<L>, matrix_operand<R>, matrix_plus>(
+      std::forward<L>(lhs), std::forward<R>(rhs));
+}
+
+template <typename L, typename R, typename = enable_if_matrix_exprs<L, R>>
+MatrixBinaryExpr<matrix_operand<L>, matrix_operand<R>, matrix_minus>
+operator-(L&& lhs, R&& rhs) {
+  return MatrixBinaryExpr<matrix_operand<L>, matrix_operand<R>, matrix_minus>(
+      std::forward<L>(lhs), std::forward<R>(rhs));
+}
+
+template <typename E, typename = enable_if_matrix_exprs<E, E>>
+MatrixNegatedExpr<matrix_operand<E>> operator-(E&& expr) {
+  return MatrixNegatedExpr<matrix_operand<E>>(std::forward<E>(expr));
+}
+
+template <typename E, typename = enable_if_matrix_exprs<E, E>>
+MatrixScaledExpr<matrix_operand<E>> operator*(
+    const typename std::decay<E>::type::value_type& lhs, E&& rhs) {
+  return MatrixScaledExpr<matrix_operand<E>>(std::forward<E>(rhs), lhs);
+}
+
+template <typename E, typename = enable_if_matrix_exprs<E, E>>
+MatrixScaledExpr<matrix_operand<E>> operator*(
+    E&& lhs, const typename std::decay<E>::type::value_type& rhs) {
+  return MatrixScaledExpr<matrix_operand<E>>(std::forward<E>(lhs), rhs);
+}
+
+// A product involving an unevaluated expression evaluates it first and then
+// multiplies matrices; Matrix * Matrix itself is a friend of Matrix.
+template <typename L, typename R, typename = enable_if_matrix_exprs<L, R>,
+          typename = typename std::enable_if<
+              !(is_matrix<L>::value && is_matrix<R>::value)>::type>
+auto operator*(const L& lhs, const R& rhs) {
+  return Matrix<L::rows, L::cols, typename L::value_type>(lhs) *
+         Matrix<R::rows, R::cols, typename R::value_type>(rhs);
+}
+
+template <typename L, typename R, typename = enable_if_matrix_exprs<L, R>>
+bool operator==(const L& lhs, const R& rhs) {
+  static_assert(L::rows == R::rows && L::cols == R::cols,
+                "Matrix dimensions do not match");
+  for (size_t idx = 0; idx < L::rows; ++idx) {
+    for (size_t jdx = 0; jdx < L::cols; ++jdx) {
+      if (lhs(idx, jdx) != rhs(idx, jdx)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template <typename L, typename R, typename = enable_if_matrix_exprs<L, R>>
+bool operator!=(const L& lhs, const R& rhs) {
+  return !(lhs == rhs);
+}
@@ -0,0 +1,346 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "dynamic_matrix.hpp"
+
+// Binary matrix files: a 32-byte header followed by the elements in
+// row-major order, in the byte order of the machine that wrote them. Only
+// plain arithmetic element types have a binary form; every type with
+// stream operators can use the text format "rows cols" followed by the
+// elements separated by whitespace.
+template<typename T>
+struct matrix_element_code {
+  static const uint32_t value = 0;
+};
+
+template<>
+struct matrix_element_code<int32_t> {
+  static const uint32_t value = 1;
+};
+
+template<>
+struct matrix_element_code<int64_t> {
+  static const uint32_t value = 2;
+};
+
+template<>
+struct matrix_element_code<uint32_t> {
+  static const uint32_t value = 3;
+};
+
+template<>
+struct matrix_element_code<uint64_t> {
+  static const uint32_t value = 4;
+};
+
+template<>
+struct matrix_element_code<float> {
+  static const uint32_t value = 5;
+};
+
+template<>
+struct matrix_element_code<double> {
+  static const uint32_t value = 6;
+};
+
+struct MatrixFileHeader {
+  static const uint32_t magicValue = 0x5852544d;  // "MTRX"
+  static const uint32_t currentVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t elementCode;
+  uint32_t elementSize;
+  uint64_t rows;
+  uint64_t cols;
+
+  template<typename T>
+  static MatrixFileHeader make(size_t rows, size_t cols) {
+    static_assert(matrix_element_code<T>::value != 0,
+                  "Element type has no binary matrix format");
+    return MatrixFileHeader{magicValue, currentVersion, matrix_element_code<T>::value,
+                            sizeof(T), rows, cols};
+  }
+
+  // Throws std::runtime_error unless this is a valid header for T.
+  template<typename T>
+  void check() const {
+    if (magic != magicValue || version != currentVersion) {
+      throw std::runtime_error("Not a matrix file");
+    }
+    if (elementCode != matrix_element_code<T>::value || elementSize != sizeof(T)) {
+      throw std::runtime_error("Matrix file has a different element type");
+    }
+  }
+};
+
+template<typename T>
+void writeBinaryElements(std::ostream& out, const T* data, size_t rows, size_t cols) {
+  MatrixFileHeader header = MatrixFileHeader::make<T>(rows, cols);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(data), rows * cols * sizeof(T));
+  if (!out) {
+    throw std::runtime_error("Failed to write matrix");
+  }
+}
+
+inline MatrixFileHeader readMatrixHeader(std::istream& in) {
+  MatrixFileHeader header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    throw std::runtime_error("Truncated matrix file");
+  }
+  return header;
+}
+
+// Sets failbit on in and throws std::runtime_error.
+inline void failMatrixStream(std::istream& in, const char* message) {
+  in.setstate(std::ios::failbit);
+  throw std::runtime_error(message);
+}
+
+// Checks that rows x cols elements of T can be addressed without overflow,
+// before anything of that size is allocated.
+template<typename T>
+void checkMatrixSize(std::istream& in, uint64_t rows, uint64_t cols) {
+  const uint64_t maxElements = std::numeric_limits<size_t>::max() / sizeof(T);
+  if (rows > maxElements || cols > maxElements ||
+      (cols != 0 && rows > maxElements / cols)) {
+    failMatrixStream(in, "Matrix dimensions are too large");
+  }
+}
+
+// Reads the header of a binary matrix of T; a header for another type
+// fails the stream.
+template<typename T>
+MatrixFileHeader readMatrixHeader(std::istream& in) {
+  MatrixFileHeader header = readMatrixHeader(in);
+  try {
+    header.check<T>();
+  } catch (...) {
+    in.setstate(std::ios::failbit);
+    throw;
+  }
+  return header;
+}
+
+// Reads the header of a binary matrix of T of any shape. The dimensions
+// must fit in memory and, when the stream is seekable, in the bytes that
+// follow the header, as MappedMatrix checks against the file size.
+template<typename T>
+MatrixFileHeader readDynamicMatrixHeader(std::istream& in) {
+  MatrixFileHeader header = readMatrixHeader<T>(in);
+  checkMatrixSize<T>(in, header.rows, header.cols);
+  std::istream::pos_type start = in.tellg();
+  if (start == std::istream::pos_type(-1)) {
+    return header;
+  }
+  if (!in.seekg(0, std::ios::end)) {
+    in.clear();  // not seekable after all; read on from start
+    return header;
+  }
+  std::istream::pos_type end = in.tellg();
+  in.seekg(start);
+  if (end == std::istream::pos_type(-1) ||
+      uint64_t(end - start) / sizeof(T) / std::max<uint64_t>(header.cols, 1) < header.rows) {
+    failMatrixStream(in, "Truncated matrix file");
+  }
+  return header;
+}
+
+template<typename T>
+void readBinaryElements(std::istream& in, T* data, size_t count) {
+  if (!in.read(reinterpret_cast<char*>(data), count * sizeof(T))) {
+    throw std::runtime_error("Truncated matrix file");
+  }
+}
+
+template<typename T>
+void writeTextElements(std::ostream& out, const T* data, size_t rows, size_t cols) {
+  out << rows << ' ' << cols << '\n';
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      out << data[i * cols + j] << (j + 1 == cols ? '\n' : ' ');
+    }
+  }
+  if (!out) {
+    throw std::runtime_error("Failed to write matrix");
+  }
+}
+
+inline void readTextDimensions(std::istream& in, size_t& rows, size_t& cols) {
+  if (!(in >> rows >> cols)) {
+    throw std::runtime_error("Malformed matrix dimensions");
+  }
+}
+
+template<typename T>
+void readTextElements(std::istream& in, T* data, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (!(in >> data[i])) {
+      throw std::runtime_error("Malformed or truncated matrix");
+    }
+  }
+}
+
+template<size_t H, size_t W, typename T>
+void writeBinary(std::ostream& out, const Matrix<H, W, T>& matrix) {
+  writeBinaryElements(out, matrix.data(), H, W);
+}
+
+template<typename T>
+void writeBinary(std::ostream& out, const DynamicMatrix<T>& matrix) {
+  writeBinaryElements(out, matrix.data(), matrix.Rows(), matrix.Columns());
+}
+
+// Reads straight into the matrix storage. Throws std::runtime_error on a
+// malformed file and std::invalid_argument if the dimensions differ.
+template<size_t H, size_t W, typename T>
+void readBinary(std::istream& in, Matrix<H, W, T>& matrix) {
+  MatrixFileHeader header = readMatrixHeader<T>(in);
+  if (header.rows != H || header.cols != W) {
+    throw std::invalid_argument("Matrix file does not fit the Matrix shape");
+  }
+  readBinaryElements(in, matrix.data(), H * W);
+}
+
+// Throws std::runtime_error and fails the stream on a malformed header,
+// including dimensions that overflow or exceed the rest of the stream.
+template<typename T>
+DynamicMatrix<T> readBinary(std::istream& in) {
+  MatrixFileHeader header = readDynamicMatrixHeader<T>(in);
+  DynamicMatrix<T> matrix(header.rows, header.cols);
+  readBinaryElements(in, matrix.data(), header.rows * header.cols);
+  return matrix;
+}
+
+template<size_t H, size_t W, typename T>
+void writeText(std::ostream& out, const Matrix<H, W, T>& matrix) {
+  writeTextElements(out, matrix.data(), H, W);
+}
+
+template<typename T>
+void writeText(std::ostream& out, const DynamicMatrix<T>& matrix) {
+  writeTextElements(out, matrix.data(), matrix.Rows(), matrix.Columns());
+}
+
+// Parses elements one by one into the final storage, without building rows.
+template<size_t H, size_t W, typename T>
+void readText(std::istream& in, Matrix<H, W, T>& matrix) {
+  size_t rows, cols;
+  readTextDimensions(in, rows, cols);
+  if (rows != H || cols != W) {
+    throw std::invalid_argument("Matrix text does not fit the Matrix shape");
+  }
+  readTextElements(in, matrix.data(), H * W);
+}
+
+template<typename T>
+DynamicMatrix<T> readText(std::istream& in) {
+  size_t rows, cols;
+  readTextDimensions(in, rows, cols);
+  checkMatrixSize<T>(in, rows, cols);
+  DynamicMatrix<T> matrix(rows, cols);
+  readTextElements(in, matrix.data(), rows * cols);
+  return matrix;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// Read-only matrix backed by a memory-mapped binary file. Nothing is copied
+// or read up front: the kernel pages elements in as they are touched, so
+// opening a file of 10^8 elements is immediate. Throws std::runtime_error
+// if the file cannot be opened or is not a matrix of T. Only available
+// where POSIX mmap is.
+template<typename T>
+class MappedMatrix {
+ private:
+  void* map_ = nullptr;
+  size_t length_ = 0;
+  size_t rows_ = 0;
+  size_t cols_ = 0;
+  const T* a_ = nullptr;
+
+  void release() {
+    if (map_ != nullptr) {
+      munmap(map_, length_);
+    }
+    map_ = nullptr;
+    length_ = 0;
+  }
+
+ public:
+  explicit MappedMatrix(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(MatrixFileHeader)) {
+      close(fd);
+      throw std::runtime_error("Truncated matrix file " + path);
+    }
+    length_ = info.st_size;
+    map_ = mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map_ == MAP_FAILED) {
+      map_ = nullptr;
+      throw std::runtime_error("Cannot map " + path);
+    }
+    MatrixFileHeader header;
+    std::memcpy(&header, map_, sizeof(header));
+    try {
+      header.check<T>();
+      if ((length_ - sizeof(header)) / sizeof(T) / std::max<uint64_t>(header.cols, 1) <
+          header.rows) {
+        throw std::runtime_error("Truncated matrix file " + path);
+      }
+    } catch (...) {
+      release();
+      throw;
+    }
+    rows_ = header.rows;
+    cols_ = header.cols;
+    a_ = reinterpret_cast<const T*>(static_cast<const char*>(map_) + sizeof(header));
+  }
+  MappedMatrix(const MappedMatrix&) = delete;
+  MappedMatrix& operator=(const MappedMatrix&) = delete;
+  MappedMatrix(MappedMatrix&& matrix) noexcept
+      : map_(matrix.map_), length_(matrix.length_), rows_(matrix.rows_),
+        cols_(matrix.cols_), a_(matrix.a_) {
+    matrix.map_ = nullptr;
+    matrix.length_ = 0;
+  }
+  MappedMatrix& operator=(MappedMatrix&& matrix) noexcept {
+    std::swap(map_, matrix.map_);
+    std::swap(length_, matrix.length_);
+    std::swap(rows_, matrix.rows_);
+    std::swap(cols_, matrix.cols_);
+    std::swap(a_, matrix.a_);
+    return *this;
+  }
+  ~MappedMatrix() { release(); }
+  size_t Rows() const { return rows_; }
+  size_t Columns() const { return cols_; }
+  const T& operator()(const size_t& idx, const size_t& jdx) const {
+    return a_[idx * cols_ + jdx];
+  }
+  const T* data() const { return a_; }
+  explicit operator DynamicMatrix<T>() const {
+    DynamicMatrix<T> matrix(rows_, cols_);
+    std::copy(a_, a_ + rows_ * cols_, matrix.data());
+    return matrix;
+  }
+};
+#endif
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "matrix.hpp"
+
+// H x W matrix in compressed sparse row form: the nonzero elements of row i
+// are values_[rowStart_[i] .. rowStart_[i + 1]) in increasing column order.
+// Products with dense matrices and vectors only touch nonzero elements, so
+// no 0 * x is ever computed, which matters for Rational and BigInteger.
+template <size_t H, size_t W, typename T = int64_t>
+class SparseMatrix {
+ private:
+  std::vector<size_t> rowStart_;
+  std::vector<size_t> columns_;
+  std::vector<T> values_;
+
+  void push(size_t jdx, const T& elem) {
+    if (elem != T(0)) {
+      columns_.push_back(jdx);
+      values_.push_back(elem);
+    }
+  }
+
+  // Runs rowTask(first, last) over consecutive row ranges, on the pool when
+  // the product is large enough to be worth it.
+  template <typename F>
+  static void forRows(size_t work, F rowTask) {
+    typedef gemm_tiling<T> tiling;
+    ThreadPool& pool = ThreadPool::global();
+    if (pool.size() <= 1 || work < tiling::serialThreshold) {
+      rowTask(0, H);
+      return;
+    }
+    size_t chunks = (H + tiling::tileRows - 1) / tiling::tileRows;
+    pool.parallelFor(chunks, [&](size_t chunk) {
+      rowTask(chunk * tiling::tileRows, std::min(H, (chunk + 1) * tiling::tileRows));
+    });
+  }
+
+ public:
+  SparseMatrix() : rowStart_(H + 1, 0) {}
+  SparseMatrix(const std::vector<std::vector<T>>& matrix) {
+    rowStart_.reserve(H + 1);
+    rowStart_.push_back(0);
+    for (size_t idx = 0; idx < H; ++idx) {
+      for (size_t jdx = 0; jdx < W; ++jdx) {
+        push(jdx, matrix[idx][jdx]);
+      }
+      rowStart_.push_back(values_.size());
+    }
+  }
+  explicit SparseMatrix(const Matrix<H, W, T>& matrix) {
+    rowStart_.reserve(H + 1);
+    rowStart_.push_back(0);
+    for (size_t idx = 0; idx < H; ++idx) {
+      for (size_t jdx = 0; jdx < W; ++jdx) {
+        push(jdx, matrix(idx, jdx));
+      }
+      rowStart_.push_back(values_.size());
+    }
+  }
+  explicit operator Matrix<H, W, T>() const {
+    Matrix<H, W, T> matr;
+    for (size_t idx = 0; idx < H; ++idx) {
+      for (size_t k = rowStart_[idx]; k < rowStart_[idx + 1]; ++k) {
+        matr(idx, columns_[k]) = values_[k];
+      }
+    }
+    return matr;
+  }
+  size_t NonZeros() const { return values_.size(); }
+  // Binary search in the row; T(0) for elements that are not stored.
+  T operator()(const size_t& idx, const size_t& jdx) const {
+    auto first = columns_.begin() + rowStart_[idx];
+    auto last = columns_.begin() + rowStart_[idx + 1];
+    auto it = std::lower_bound(first, last, jdx);
+    if (it == last || *it != jdx) {
+      return T(0);
+    }
+    return values_[it - columns_.begin()];
+  }
+  bool operator==(const SparseMatrix& rhs) const {
+    return rowStart_ == rhs.rowStart_ && columns_ == rhs.columns_ &&
+           values_ == rhs.values_;
+  }
+  bool operator!=(const SparseMatrix& rhs) const { return !(*this == rhs); }
+
+  // Sparse matrix times a vector of size W; throws std::invalid_argument on
+  // a size mismatch.
+  friend std::vector<T> operator*(const SparseMatrix& lhs, const std::vector<T>& rhs) {
+    if (rhs.size() != W) {
+      throw std::invalid_argument("Vector size does not match the matrix");
+    }
+    std::vector<T> result(H, T(0));
+    forRows(lhs.NonZeros(), [&](size_t first, size_t last) {
+      for (size_t idx = first; idx < last; ++idx) {
+        T sum = T(0);
+        for (size_t k = lhs.rowStart_[idx]; k < lhs.rowStart_[idx + 1]; ++k) {
+          sum += lhs.values_[k] * rhs[lhs.columns_[k]];
+        }
+        result[idx] = sum;
+      }
+    });
+    return result;
+  }
+  // Row i of the result is the sum of the rows of rhs picked by the nonzero
+  // elements of row i of lhs.
+  template <size_t W1>
+  friend Matrix<H, W1, T> operator*(const SparseMatrix& lhs, const Matrix<W, W1, T>& rhs) {
+    Matrix<H, W1, T> matr;
+    forRows(lhs.NonZeros() * W1, [&](size_t first, size_t last) {
+      for (size_t idx = first; idx < last; ++idx) {
+        for (size_t k = lhs.rowStart_[idx]; k < lhs.rowStart_[idx + 1]; ++k) {
+          const T& elem = lhs.values_[k];
+          size_t row = lhs.columns_[k];
+          for (size_t jdx = 0; jdx < W1; ++jdx) {
+            matr(idx, jdx) += elem * rhs(row, jdx);
+          }
+        }
+      }
+    });
+    return matr;
+  }
+  // Zero elements of the dense lhs are skipped as well.
+  template <size_t H1>
+  friend Matrix<H1, W, T> operator*(const Matrix<H1, H, T>& lhs, const SparseMatrix& rhs) {
+    Matrix<H1, W, T> matr;
+    for (size_t idx = 0; idx < H1; ++idx) {
+      for (size_t row = 0; row < H; ++row) {
+        const T& elem = lhs(idx, row);
+        if (elem == T(0)) {
+          continue;
+        }
+        for (size_t k = rhs.rowStart_[row]; k < rhs.rowStart_[row + 1]; ++k) {
+          matr(idx, rhs.columns_[k]) += elem * rhs.values_[k];
+        }
+      }
+    }
+    return matr;
+  }
+};
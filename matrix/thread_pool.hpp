@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with one task deque each. A worker takes
+// tasks from the back of its own deque and, once that is empty, steals from
+// the front of the others, so uneven tasks (e.g. tiles of Rational matrices)
+// even out. Tasks must not throw.
+class ThreadPool {
+ private:
+  typedef std::function<void()> Task;
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::mutex sleepMutex_;
+  std::condition_variable wakeUp_;
+  std::atomic<size_t> queued_{0};
+  bool stop_ = false;
+
+  bool popOwn(size_t id, Task& task) {
+    Worker& worker = *workers_[id];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+      return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    --queued_;
+    return true;
+  }
+
+  bool steal(size_t from, Task& task) {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      Worker& victim = *workers_[(from + i) % workers_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (victim.tasks.empty()) {
+        continue;
+      }
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      --queued_;
+      return true;
+    }
+    return false;
+  }
+
+  void run(size_t id) {
+    Task task;
+    while (true) {
+      if (popOwn(id, task) || steal(id + 1, task)) {
+        task();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleepMutex_);
+      wakeUp_.wait(lock, [this] { return stop_ || queued_ > 0; });
+      if (stop_ && queued_ == 0) {
+        return;
+      }
+    }
+  }
+
+  static std::unique_ptr<ThreadPool>& globalPool() {
+    static std::unique_ptr<ThreadPool> pool(new ThreadPool());
+    return pool;
+  }
+
+ public:
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency()) {
+    for (size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back(new Worker());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+      threads_.emplace_back(&ThreadPool::run, this, i);
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex_);
+      stop_ = true;
+    }
+    wakeUp_.notify_all();
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      threads_[i].join();
+    }
+  }
+
+  size_t size() const {
+    return threads_.size();
+  }
+
+  // Runs task(i) for every i < count and returns when all of them are done.
+  // Consecutive indices go to the same worker; the calling thread steals
+  // work too, so a pool without threads simply runs everything inline.
+  template <typename F>
+  void parallelFor(size_t count, F task) {
+    std::atomic<size_t> remaining(count);
+    std::mutex doneMutex;
+    std::condition_variable done;
+    // Decremented under the lock, so that the waiter cannot return and
+    // destroy doneMutex while the last task is still notifying.
+    auto finish = [&]() {
+      std::lock_guard<std::mutex> lock(doneMutex);
+      if (--remaining == 0) {
+        done.notify_all();
+      }
+    };
+    if (!workers_.empty()) {
+      for (size_t w = 0; w < workers_.size(); ++w) {
+        Worker& worker = *workers_[w];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        for (size_t i = count * w / workers_.size(); i < count * (w + 1) / workers_.size(); ++i) {
+          worker.tasks.push_back([&task, &finish, i]() {
+            task(i);
+            finish();
+          });
+          ++queued_;
+        }
+      }
+      {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+      }
+      wakeUp_.notify_all();
+      Task stolen;
+      while (remaining > 0 && steal(0, stolen)) {
+        stolen();
+      }
+    } else {
+      for (size_t i = 0; i < count; ++i) {
+        task(i);
+        finish();
+      }
+    }
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&remaining] { return remaining == 0; });
+  }
+
+  // Pool used by matrix products. Resizing it must not race with products
+  // that are running.
+  static ThreadPool& global() {
+    return *globalPool();
+  }
+
+  static void setGlobalThreads(size_t threads) {
+    globalPool().reset(new ThreadPool(threads));
+  }
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+// Cache-oblivious transposition: the larger dimension is halved until a
+// block fits in L1 on any cache size, so reads and writes both stay within
+// a few cache lines instead of striding through the whole output.
+const size_t transposeLeaf = 16;
+
+// b = a^T, where a is rows x cols with row stride lda and b is cols x rows
+// with row stride ldb.
+template<typename T>
+void transpose(const T* a, T* b, size_t rows, size_t cols, size_t lda, size_t ldb) {
+  if (rows <= transposeLeaf && cols <= transposeLeaf) {
+    for (size_t i = 0; i < rows; ++i) {
+      for (size_t j = 0; j < cols; ++j) {
+        b[j * ldb + i] = a[i * lda + j];
+      }
+    }
+  } else if (rows >= cols) {
+    size_t half = rows / 2;
+    transpose(a, b, half, cols, lda, ldb);
+    transpose(a + half * lda, b + half, rows - half, cols, lda, ldb);
+  } else {
+    size_t half = cols / 2;
+    transpose(a, b, rows, half, lda, ldb);
+    transpose(a + half, b + half * ldb, rows, cols - half, lda, ldb);
+  }
+}
+
+// Swaps the rows x cols block x with the transpose of the cols x rows
+// block y; both have row stride ld and must not overlap.
+template<typename T>
+void swapTransposed(T* x, T* y, size_t rows, size_t cols, size_t ld) {
+  if (rows <= transposeLeaf && cols <= transposeLeaf) {
+    for (size_t i = 0; i < rows; ++i) {
+      for (size_t j = 0; j < cols; ++j) {
+        std::swap(x[i * ld + j], y[j * ld + i]);
+      }
+    }
+  } else if (rows >= cols) {
+    size_t half = rows / 2;
+    swapTransposed(x, y, half, cols, ld);
+    swapTransposed(x + half * ld, y + half, rows - half, cols, ld);
+  } else {
+    size_t half = cols / 2;
+    swapTransposed(x, y, rows, half, ld);
+    swapTransposed(x + half, y + half * ld, rows, cols - half, ld);
+  }
+}
+
+// Transposes the n x n matrix a with row stride lda in place.
+template<typename T>
+void transposeInPlace(T* a, size_t n, size_t lda) {
+  if (n <= transposeLeaf) {
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = i + 1; j < n; ++j) {
+        std::swap(a[i * lda + j], a[j * lda + i]);
+      }
+    }
+    return;
+  }
+  size_t half = n / 2;
+  transposeInPlace(a, half, lda);
+  transposeInPlace(a + half * lda + half, n - half, lda);
+  swapTransposed(a + half, a + half * lda, half, n - half, lda);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "residue.hpp"
+
+// Factorials and inverse factorials modulo a prime N, grown on demand and
+// shared by all callers. A table generation is never modified after it is
+// published, so lookups below the built size take no lock; growth replaces
+// the current generation under a mutex and keeps the old ones alive for
+// readers still holding them.
+template<unsigned N>
+class Combinatorics {
+  static_assert(is_prime_v<N>, "Combinatorics requires a prime modulus");
+
+  // Stored side by side: binom() touches one factorial and two inverses.
+  struct Entry {
+    Residue<N> factorial;
+    Residue<N> inverseFactorial;
+  };
+
+  typedef std::vector<Entry> Table;
+
+  struct State {
+    std::atomic<const Table*> current;
+    std::vector<std::unique_ptr<Table>> generations;
+    std::mutex growth;
+
+    State() {
+      generations.emplace_back(new Table(1, Entry{Residue<N>(1), Residue<N>(1)}));
+      current.store(generations.back().get(), std::memory_order_release);
+    }
+  };
+
+  static State& state() {
+    static State s;
+    return s;
+  }
+
+  static const Table& grow(size_t n) {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.growth);
+    const Table* old = s.current.load(std::memory_order_acquire);
+    if (old->size() > n)
+      return *old;
+    size_t size = std::min<size_t>(std::max(n + 1, 2 * old->size()), N);
+    std::unique_ptr<Table> table(new Table(*old));
+    table->reserve(size);
+    for (size_t i = old->size(); i < size; ++i)
+      table->push_back(Entry{table->back().factorial * Residue<N>(int(i)), Residue<N>(0)});
+    Table& t = *table;
+    t[size - 1].inverseFactorial = t[size - 1].factorial.getInverse();
+    for (size_t i = size - 1; i > old->size(); --i)
+      t[i - 1].inverseFactorial = t[i].inverseFactorial * Residue<N>(int(i));
+    s.generations.push_back(std::move(table));
+    s.current.store(&t, std::memory_order_release);
+    return t;
+  }
+
+  // Table holding at least indices 0..n, n < N.
+  static const Table& table(size_t n) {
+    const Table* t = state().current.load(std::memory_order_acquire);
+    if (t->size() > n)
+      return *t;
+    return grow(n);
+  }
+
+  static Residue<N> smallBinom(unsigned n, unsigned k) {
+    if (k > n)
+      return Residue<N>(0);
+    const Table& t = table(n);
+    return t[n].factorial * t[k].inverseFactorial * t[n - k].inverseFactorial;
+  }
+
+ public:
+  // Builds the table up to n! in advance, e.g. before sharing between threads.
+  static void reserve(size_t n) {
+    if (n >= N)
+      n = N - 1;
+    table(n);
+  }
+
+  static Residue<N> factorial(unsigned long long n) {
+    if (n >= N)
+      return Residue<N>(0);
+    return table(n)[n].factorial;
+  }
+
+  // Inverse of n!, or 0 when n! is divisible by N.
+  static Residue<N> inverseFactorial(unsigned long long n) {
+    if (n >= N)
+      return Residue<N>(0);
+    return table(n)[n].inverseFactorial;
+  }
+
+  // C(n, k); arguments not below N go through Lucas' theorem.
+  static Residue<N> binom(unsigned long long n, unsigned long long k) {
+    if (k > n)
+      return Residue<N>(0);
+    if (n < N)
+      return smallBinom(n, k);
+    Residue<N> result(1);
+    while (k > 0 && int(result) != 0) {
+      result *= smallBinom(n % N, k % N);
+      n /= N;
+      k /= N;
+    }
+    return result;
+  }
+
+  // n * (n - 1) * ... * (n - k + 1)
+  static Residue<N> perm(unsigned long long n, unsigned long long k) {
+    if (k > n)
+      return Residue<N>(0);
+    unsigned long long r = n % N;
+    if (k > r)
+      return Residue<N>(0);
+    const Table& t = table(r);
+    return t[r].factorial * t[r - k].inverseFactorial;
+  }
+
+  static Residue<N> catalan(unsigned long long n) {
+    return binom(2 * n, n) - binom(2 * n, n + 1);
+  }
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include "residue.hpp"
+
+// Modulus known only at runtime, 1 <= modulus < 2^31. Everything that
+// depends on the modulus alone is computed once here: the Barrett constant
+// used for division-free multiplication, phi(modulus) and the factorisation.
+class DynModulus {
+  unsigned modulus;
+  unsigned long long barrett;
+  unsigned phiValue = 1;
+  std::vector<unsigned> primeDivisors;
+
+  // High 64 bits of a * b. GCC and Clang have a 128-bit type for this;
+  // elsewhere the product is assembled from 32-bit halves.
+  static unsigned long long mulHigh(unsigned long long a, unsigned long long b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 uint128;
+    return (unsigned long long)(((uint128)a * b) >> 64);
+#else
+    unsigned long long aLow = a & 0xffffffffULL, aHigh = a >> 32;
+    unsigned long long bLow = b & 0xffffffffULL, bHigh = b >> 32;
+    unsigned long long low = aLow * bLow;
+    unsigned long long middle1 = aHigh * bLow + (low >> 32);
+    unsigned long long middle2 = aLow * bHigh + (middle1 & 0xffffffffULL);
+    return aHigh * bHigh + (middle1 >> 32) + (middle2 >> 32);
+#endif
+  }
+
+ public:
+  explicit DynModulus(unsigned m): modulus(m), barrett((unsigned long long)(-1) / m + 1) {
+    unsigned rest = m;
+    while (rest > 1) {
+      unsigned p = minimalDivisor(rest);
+      primeDivisors.push_back(p);
+      phiValue *= p - 1;
+      rest /= p;
+      while (rest % p == 0) {
+        phiValue *= p;
+        rest /= p;
+      }
+    }
+  }
+
+  unsigned get() const {
+    return modulus;
+  }
+
+  unsigned phi() const {
+    return phiValue;
+  }
+
+  bool isPrime() const {
+    return modulus > 1 && primeDivisors.size() == 1 && primeDivisors[0] == modulus;
+  }
+
+  // Same condition as has_primitive_root: 1, 2, 4, p^k and 2p^k for odd p.
+  bool hasPrimitiveRoot() const {
+    if (modulus <= 4)
+      return true;
+    if (modulus % 4 == 0)
+      return false;
+    return primeDivisors.size() == 1 || (primeDivisors.size() == 2 && primeDivisors[0] == 2);
+  }
+
+  // Barrett reduction of z < 2^64, no hardware division.
+  unsigned reduce(unsigned long long z) const {
+    unsigned long long q = mulHigh(z, barrett);
+    unsigned long long y = q * modulus;
+    return unsigned(z - y + (z < y ? modulus : 0));
+  }
+};
+
+// Residue modulo a DynModulus, with the operator set of Residue<N>. The
+// context is referenced, not copied: it must outlive its residues, and
+// both operands of a binary operation must share it. A default-constructed
+// residue has no modulus yet and may only be assigned to or compared.
+class DynResidue {
+  friend std::istream& operator>>(std::istream& in, DynResidue& r) {
+    long long x;
+    in >> x;
+    r = DynResidue(*r.modulus, x);
+    return in;
+  }
+
+  const DynModulus* modulus = nullptr;
+  unsigned value = 0;
+
+ public:
+  DynResidue() = default;
+  DynResidue(const DynModulus& m, long long x): modulus(&m),
+      value(unsigned(((x % (long long)m.get()) + m.get()) % m.get())) {}
+
+  explicit operator int() const {
+    return value;
+  }
+
+  const DynModulus& getModulus() const {
+    return *modulus;
+  }
+
+  DynResidue pow(signed k) const = delete;
+
+  DynResidue pow(unsigned k) const {
+    DynResidue result(*modulus, 1);
+    DynResidue base = *this;
+    for (; k > 0; k /= 2) {
+      if (k % 2 == 1)
+        result *= base;
+      base *= base;
+    }
+    return result;
+  }
+
+  DynResidue& operator+=(const DynResidue& a) {
+    value += a.value;
+    if (value >= modulus->get())
+      value -= modulus->get();
+    return *this;
+  }
+
+  DynResidue& operator-=(const DynResidue& a) {
+    value += modulus->get() - a.value;
+    if (value >= modulus->get())
+      value -= modulus->get();
+    return *this;
+  }
+
+  DynResidue& operator*=(const DynResidue& a) {
+    value = modulus->reduce(1ULL * value * a.value);
+    return *this;
+  }
+
+  int order() const {
+    if (::gcd(value, modulus->get()) != 1)
+      return 0;
+
+    unsigned f = modulus->phi();
+    unsigned ans = modulus->get();
+    for (unsigned i = 1; i * i <= f; ++i) {
+      if (f % i != 0)
+        continue;
+      if (int(pow(i)) == 1)
+        return i;
+      if (int(pow(f / i)) == 1)
+        ans = std::min(ans, f / i);
+    }
+    return ans;
+  }
+
+  // Extended Euclid; 0 when gcd(value, modulus) != 1.
+  DynResidue getInverse() const {
+    long long a = value, b = modulus->get(), x = 1, y = 0;
+    while (b != 0) {
+      long long q = a / b;
+      a -= q * b;
+      std::swap(a, b);
+      x -= q * y;
+      std::swap(x, y);
+    }
+    if (a != 1)
+      return DynResidue(*modulus, 0);
+    return DynResidue(*modulus, x);
+  }
+
+  DynResidue& operator/=(const DynResidue& a) {
+    return *this *= a.getInverse();
+  }
+
+  // 0 when the modulus has no primitive root.
+  static DynResidue getPrimitiveRoot(const DynModulus& m) {
+    if (!m.hasPrimitiveRoot())
+      return DynResidue(m, 0);
+    if (m.get() <= 2)
+      return DynResidue(m, 1);
+    if (m.get() == 4)
+      return DynResidue(m, 3);
+    unsigned fi = m.phi();
+    std::vector<unsigned> primeDivisors;
+    unsigned rest = fi;
+    while (rest > 1) {
+      unsigned p = minimalDivisor(rest);
+      primeDivisors.push_back(p);
+      while (rest % p == 0)
+        rest /= p;
+    }
+    for (unsigned x = 2; x < m.get(); ++x) {
+      if (::gcd(x, m.get()) != 1)
+        continue;
+      DynResidue t(m, x);
+      bool is = true;
+      for (size_t i = 0; i < primeDivisors.size(); ++i) {
+        if (int(t.pow(fi / primeDivisors[i])) == 1) {
+          is = false;
+          break;
+        }
+      }
+      if (is)
+        return t;
+    }
+    return DynResidue(m, 0);
+  }
+};
+
+inline bool operator==(const DynResidue& a, const DynResidue& b) {
+  return int(a) == int(b);
+}
+
+inline bool operator!=(const DynResidue& a, const DynResidue& b) {
+  return !(a == b);
+}
+
+inline DynResidue operator+(const DynResidue& a, const DynResidue& b) {
+  DynResidue c = a;
+  c += b;
+  return c;
+}
+
+inline DynResidue operator-(const DynResidue& a, const DynResidue& b) {
+  DynResidue c = a;
+  c -= b;
+  return c;
+}
+
+inline DynResidue operator*(const DynResidue& a, const DynResidue& b) {
+  DynResidue c = a;
+  c *= b;
+  return c;
+}
+
+inline DynResidue operator/(const DynResidue& a, const DynResidue& b) {
+  DynResidue c = a;
+  c /= b;
+  return c;
+}
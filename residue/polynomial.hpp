@@ -0,0 +1,374 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "residue.hpp"
+
+constexpr unsigned twoAdicity(unsigned n) {
+  unsigned k = 0;
+  while (n != 0 && n % 2 == 0) {
+    n /= 2;
+    ++k;
+  }
+  return k;
+}
+
+// N is NTT-friendly when it is an odd prime; transforms of length up to
+// 2^two_adicity(N - 1) are then possible (2^23 for 998244353 = 119 * 2^23 + 1).
+template<unsigned N>
+struct ntt_friendly {
+  static const bool value = N > 2 && is_prime_v<N>;
+};
+
+template<unsigned N>
+const bool ntt_friendly_v = ntt_friendly<N>::value;
+
+template<unsigned N>
+class NTT {
+  static_assert(ntt_friendly_v<N>, "NTT requires an odd prime modulus");
+
+  // roots()[h + j] = w^j, where w is a primitive 2h-th root of unity,
+  // for every power of two h: one contiguous row per butterfly level.
+  static std::vector<Residue<N>>& roots() {
+    static std::vector<Residue<N>> table = {Residue<N>(0), Residue<N>(1)};
+    return table;
+  }
+
+  static void prepareRoots(size_t n) {
+    std::vector<Residue<N>>& table = roots();
+    if (table.size() >= n)
+      return;
+    static const Residue<N> g = Residue<N>::getPrimitiveRoot();
+    size_t h = table.size();
+    table.resize(n, Residue<N>(0));
+    for (; h < n; h *= 2) {
+      Residue<N> w = g.pow(unsigned((N - 1) / (2 * h)));
+      table[h] = Residue<N>(1);
+      for (size_t j = 1; j < h; ++j)
+        table[h + j] = table[h + j - 1] * w;
+    }
+  }
+
+ public:
+  static const size_t maxSize = size_t(1) << twoAdicity(N - 1);
+
+  // In-place transform, a.size() must be a power of two not exceeding maxSize.
+  // The root table is cached between calls and is not guarded against
+  // concurrent growth: call prepare() with the largest size up front when
+  // transforming from several threads.
+  static void transform(std::vector<Residue<N>>& a, bool invert) {
+    size_t n = a.size();
+    if (n > maxSize)
+      throw std::length_error("NTT size exceeds the two-adicity of the modulus");
+    if (n <= 1)
+      return;
+    for (size_t i = 1, j = 0; i < n; ++i) {
+      size_t bit = n / 2;
+      for (; j & bit; bit /= 2)
+        j ^= bit;
+      j ^= bit;
+      if (i < j)
+        std::swap(a[i], a[j]);
+    }
+    prepareRoots(n);
+    const std::vector<Residue<N>>& table = roots();
+    for (size_t h = 1; h < n; h *= 2) {
+      for (size_t i = 0; i < n; i += 2 * h) {
+        for (size_t j = 0; j < h; ++j) {
+          Residue<N> u = a[i + j];
+          Residue<N> v = a[i + j + h] * table[h + j];
+          a[i + j] = u + v;
+          a[i + j + h] = u - v;
+        }
+      }
+    }
+    if (invert) {
+      std::reverse(a.begin() + 1, a.end());
+      Residue<N> inverseSize = Residue<N>(int(n)).getInverse();
+      for (size_t i = 0; i < n; ++i)
+        a[i] *= inverseSize;
+    }
+  }
+
+  static void prepare(size_t n) {
+    prepareRoots(n);
+  }
+
+  static std::vector<Residue<N>> multiply(std::vector<Residue<N>> a,
+                                          std::vector<Residue<N>> b) {
+    if (a.empty() || b.empty())
+      return std::vector<Residue<N>>();
+    size_t resultSize = a.size() + b.size() - 1;
+    size_t n = 1;
+    while (n < resultSize)
+      n *= 2;
+    a.resize(n, Residue<N>(0));
+    b.resize(n, Residue<N>(0));
+    transform(a, false);
+    transform(b, false);
+    for (size_t i = 0; i < n; ++i)
+      a[i] *= b[i];
+    transform(a, true);
+    a.resize(resultSize, Residue<N>(0));
+    return a;
+  }
+};
+
+template<unsigned N>
+std::vector<Residue<N>> naiveMultiply(const std::vector<Residue<N>>& a,
+                                      const std::vector<Residue<N>>& b) {
+  if (a.empty() || b.empty())
+    return std::vector<Residue<N>>();
+  std::vector<Residue<N>> c(a.size() + b.size() - 1, Residue<N>(0));
+  for (size_t i = 0; i < a.size(); ++i)
+    for (size_t j = 0; j < b.size(); ++j)
+      c[i + j] += a[i] * b[j];
+  return c;
+}
+
+template<unsigned N, bool Friendly>
+struct multiplier {
+  static const size_t naiveThreshold = 32;
+
+  static std::vector<Residue<N>> multiply(const std::vector<Residue<N>>& a,
+                                          const std::vector<Residue<N>>& b) {
+    if (std::min(a.size(), b.size()) <= naiveThreshold ||
+        a.size() + b.size() - 1 > NTT<N>::maxSize)
+      return naiveMultiply(a, b);
+    return NTT<N>::multiply(a, b);
+  }
+};
+
+template<unsigned N>
+struct multiplier<N, false> {
+  static std::vector<Residue<N>> multiply(const std::vector<Residue<N>>& a,
+                                          const std::vector<Residue<N>>& b) {
+    return naiveMultiply(a, b);
+  }
+};
+
+// Polynomial over Z/NZ, coefficients stored from the lowest degree up,
+// without trailing zeros. Division, inverse and multipoint evaluation need
+// N to be prime.
+template<unsigned N>
+class Polynomial {
+  std::vector<Residue<N>> coefficients;
+
+  void normalise() {
+    while (!coefficients.empty() && int(coefficients.back()) == 0)
+      coefficients.pop_back();
+  }
+
+  static const size_t naiveEvaluationSize = 32;
+
+  void buildTree(std::vector<Polynomial<N>>& tree, const std::vector<Residue<N>>& points,
+                 size_t node, size_t l, size_t r) const {
+    if (r - l == 1) {
+      tree[node] = Polynomial<N>({Residue<N>(0) - points[l], Residue<N>(1)});
+      return;
+    }
+    size_t m = (l + r) / 2;
+    buildTree(tree, points, 2 * node, l, m);
+    buildTree(tree, points, 2 * node + 1, m, r);
+    tree[node] = tree[2 * node] * tree[2 * node + 1];
+  }
+
+  void evaluateTree(const std::vector<Polynomial<N>>& tree, const std::vector<Residue<N>>& points,
+                    size_t node, size_t l, size_t r, std::vector<Residue<N>>& values) const {
+    if (r - l <= naiveEvaluationSize) {
+      for (size_t i = l; i < r; ++i)
+        values[i] = evaluate(points[i]);
+      return;
+    }
+    size_t m = (l + r) / 2;
+    (*this % tree[2 * node]).evaluateTree(tree, points, 2 * node, l, m, values);
+    (*this % tree[2 * node + 1]).evaluateTree(tree, points, 2 * node + 1, m, r, values);
+  }
+
+ public:
+  Polynomial() = default;
+
+  Polynomial(const std::vector<Residue<N>>& coefficients): coefficients(coefficients) {
+    normalise();
+  }
+
+  Polynomial(std::initializer_list<Residue<N>> coefficients): coefficients(coefficients) {
+    normalise();
+  }
+
+  explicit Polynomial(const Residue<N>& constant): coefficients(1, constant) {
+    normalise();
+  }
+
+  // Degree of the zero polynomial is -1.
+  int degree() const {
+    return int(coefficients.size()) - 1;
+  }
+
+  size_t size() const {
+    return coefficients.size();
+  }
+
+  bool empty() const {
+    return coefficients.empty();
+  }
+
+  Residue<N> operator[](size_t i) const {
+    return i < coefficients.size() ? coefficients[i] : Residue<N>(0);
+  }
+
+  const std::vector<Residue<N>>& getCoefficients() const {
+    return coefficients;
+  }
+
+  // First n coefficients, i.e. the polynomial modulo x^n.
+  Polynomial<N> truncated(size_t n) const {
+    n = std::min(n, coefficients.size());
+    return Polynomial<N>(std::vector<Residue<N>>(coefficients.begin(), coefficients.begin() + n));
+  }
+
+  Polynomial<N> reversed(size_t n) const {
+    std::vector<Residue<N>> result = coefficients;
+    result.resize(n, Residue<N>(0));
+    std::reverse(result.begin(), result.end());
+    return Polynomial<N>(result);
+  }
+
+  Polynomial<N>& operator+=(const Polynomial<N>& p) {
+    if (coefficients.size() < p.coefficients.size())
+      coefficients.resize(p.coefficients.size(), Residue<N>(0));
+    for (size_t i = 0; i < p.coefficients.size(); ++i)
+      coefficients[i] += p.coefficients[i];
+    normalise();
+    return *this;
+  }
+
+  Polynomial<N>& operator-=(const Polynomial<N>& p) {
+    if (coefficients.size() < p.coefficients.size())
+      coefficients.resize(p.coefficients.size(), Residue<N>(0));
+    for (size_t i = 0; i < p.coefficients.size(); ++i)
+      coefficients[i] -= p.coefficients[i];
+    normalise();
+    return *this;
+  }
+
+  Polynomial<N>& operator*=(const Polynomial<N>& p) {
+    coefficients = multiplier<N, ntt_friendly_v<N> >::multiply(coefficients, p.coefficients);
+    normalise();
+    return *this;
+  }
+
+  Polynomial<N>& operator*=(const Residue<N>& r) {
+    for (size_t i = 0; i < coefficients.size(); ++i)
+      coefficients[i] *= r;
+    normalise();
+    return *this;
+  }
+
+  // Power series inverse modulo x^n by Newton iteration: b <- b * (2 - a * b).
+  Polynomial<N> inverse(size_t n) const {
+    if (coefficients.empty() || int(coefficients[0]) == 0)
+      throw std::domain_error("Polynomial inverse requires a nonzero constant term");
+    Polynomial<N> b(coefficients[0].getInverse());
+    for (size_t m = 1; m < n; m *= 2) {
+      Polynomial<N> ab = truncated(2 * m) * b;
+      ab = ab.truncated(2 * m);
+      b = (b * (Polynomial<N>(Residue<N>(2)) - ab)).truncated(2 * m);
+    }
+    return b.truncated(n);
+  }
+
+  // Quotient of the Euclidean division, via the reversed series inverse.
+  Polynomial<N>& operator/=(const Polynomial<N>& p) {
+    if (p.empty())
+      throw std::domain_error("Polynomial division by zero");
+    if (degree() < p.degree()) {
+      coefficients.clear();
+      return *this;
+    }
+    size_t quotientSize = coefficients.size() - p.coefficients.size() + 1;
+    Polynomial<N> q = reversed(coefficients.size()).truncated(quotientSize) *
+                      p.reversed(p.coefficients.size()).inverse(quotientSize);
+    *this = q.truncated(quotientSize).reversed(quotientSize);
+    return *this;
+  }
+
+  Polynomial<N>& operator%=(const Polynomial<N>& p) {
+    if (degree() < p.degree())
+      return *this;
+    *this -= (*this / p) * p;
+    return *this;
+  }
+
+  Residue<N> evaluate(const Residue<N>& x) const {
+    Residue<N> result(0);
+    for (size_t i = coefficients.size(); i > 0; --i)
+      result = result * x + coefficients[i - 1];
+    return result;
+  }
+
+  // Values at all points in O(n log^2 n) through a subproduct tree.
+  std::vector<Residue<N>> evaluate(const std::vector<Residue<N>>& points) const {
+    std::vector<Residue<N>> values(points.size(), Residue<N>(0));
+    if (points.size() <= naiveEvaluationSize) {
+      for (size_t i = 0; i < points.size(); ++i)
+        values[i] = evaluate(points[i]);
+      return values;
+    }
+    std::vector<Polynomial<N>> tree(4 * points.size());
+    buildTree(tree, points, 1, 0, points.size());
+    (*this % tree[1]).evaluateTree(tree, points, 1, 0, points.size(), values);
+    return values;
+  }
+};
+
+template<unsigned N>
+bool operator==(const Polynomial<N>& p1, const Polynomial<N>& p2) {
+  if (p1.size() != p2.size())
+    return false;
+  for (size_t i = 0; i < p1.size(); ++i)
+    if (int(p1[i]) != int(p2[i]))
+      return false;
+  return true;
+}
+
+template<unsigned N>
+bool operator!=(const Polynomial<N>& p1, const Polynomial<N>& p2) {
+  return !(p1 == p2);
+}
+
+template<unsigned N>
+Polynomial<N> operator+(const Polynomial<N>& p1, const Polynomial<N>& p2) {
+  Polynomial<N> temp = p1;
+  temp += p2;
+  return temp;
+}
+
+template<unsigned N>
+Polynomial<N> operator-(const Polynomial<N>& p1, const Polynomial<N>& p2) {
+  Polynomial<N> temp = p1;
+  temp -= p2;
+  return temp;
+}
+
+template<unsigned N>
+Polynomial<N> operator*(const Polynomial<N>& p1, const Polynomial<N>& p2) {
+  Polynomial<N> temp = p1;
+  temp *= p2;
+  return temp;
+}
+
+template<unsigned N>
+Polynomial<N> operator/(const Polynomial<N>& p1, const Polynomial<N>& p2) {
+  Polynomial<N> temp = p1;
+  temp /= p2;
+  return temp;
+}
+
+template<unsigned N>
+Polynomial<N> operator%(const Polynomial<N>& p1, const Polynomial<N>& p2) {
+  Polynomial<N> temp = p1;
+  temp %= p2;
+  return temp;
+}
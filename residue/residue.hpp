@@ -1,15 +1,24 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
 #include <cmath>
 
+// Trial division is done by constexpr loops rather than template recursion,
+// otherwise moduli around 10^9 (e.g. the NTT prime 998244353) exceed the
+// template instantiation depth.
+constexpr unsigned minimalDivisor(unsigned n) {
+  if (n % 2 == 0)
+    return 2;
+  for (unsigned k = 3; 1ULL * k * k <= n; k += 2)
+    if (n % k == 0)
+      return k;
+  return n;
+}
+
 template<unsigned N, unsigned K>
 struct have_divisor {
-  static const bool value = (N % K == 0) ? true : have_divisor<N, K - 1>::value;
-};
-
-template<unsigned N>
-struct have_divisor<N, 1> {
-  static const bool value = false;
+  static const bool value = (K >= 2 && minimalDivisor(N) <= K);
 };
 
 template<unsigned N>
@@ -25,26 +34,15 @@ struct is_prime<1> {
 template<unsigned N>
 const bool is_prime_v = is_prime<N>::value;
 
-int gcd(int a, int b) {
+inline int gcd(int a, int b) {
   if (a == 0)
     return b;
   return gcd(b % a, a);
 }
 
-template<unsigned N, unsigned R, unsigned K>
-struct find_minimal_divisor {
-  static const int value = (N % K == 0 ? K : find_minimal_divisor<N, R, K + 2>::value);
-};
-
-template<unsigned N, unsigned R>
-struct find_minimal_divisor<N, R, R> {
-  static const unsigned value = N % R == 0 ? R : N;
-};
-
 template<unsigned N>
 struct minimal_divisor {
-  static const unsigned value = N % 2 == 0 ? 2 : \
-            find_minimal_divisor<N, (int(sqrt(N)) / 2) * 2 + 5, 3>::value;
+  static const unsigned value = minimalDivisor(N);
 };
 
 template<>
@@ -122,16 +120,31 @@ struct phi<1> {
   static const int value = 1;
 };
 
+template<unsigned N>
+class PowTable;
+
 template<unsigned N>
 class Residue {
   friend std::istream& operator>>(std::istream& in, Residue<N>& r) {
     int x;
     in >> x;
-    r.val = ((x % int(N)) + N) % N;
+    r.value = ((x % int(N)) + N) % N;
     return in;
   }
   unsigned value;
+  static const unsigned windowSize = 4;
+
+  static unsigned multiply(unsigned a, unsigned b) {
+    return (1ULL * a * b) % N;
+  }
+
+  static Residue<N> fromValue(unsigned v) {
+    Residue<N> r(0);
+    r.value = v;
+    return r;
+  }
  public:
+  Residue<N> (): value(0) {}
   explicit Residue<N> (int x): value(((x % int(N)) + N) % N) {}
   explicit operator int() const {
     return value;
@@ -139,14 +152,42 @@ class Residue {
 
   Residue<N> pow(signed k) const = delete;
 
+  // Left-to-right sliding window over the bits of k, using the odd powers
+  // value^1, value^3, ..., value^(2^windowSize - 1). Short exponents do not
+  // pay for the precomputation and use plain square-and-multiply.
   Residue<N> pow(unsigned k) const {
-    if (k == 0)
-      return Residue<N>(1);
-    if (k % 2 == 0) {
-      Residue<N> x = pow(k / 2);
-      return x * x;
+    unsigned result = 1 % N;
+    if (k < (1u << 2 * windowSize)) {
+      for (unsigned base = value; k > 0; k /= 2) {
+        if (k % 2 == 1)
+          result = multiply(result, base);
+        base = multiply(base, base);
+      }
+      return fromValue(result);
     }
-    return (*this) * pow(k - 1);
+    unsigned odd[1 << (windowSize - 1)];
+    unsigned square = multiply(value, value);
+    odd[0] = value;
+    for (unsigned i = 1; i < (1u << (windowSize - 1)); ++i)
+      odd[i] = multiply(odd[i - 1], square);
+    int bit = 31;
+    while (((k >> bit) & 1) == 0)
+      --bit;
+    while (bit >= 0) {
+      if (((k >> bit) & 1) == 0) {
+        result = multiply(result, result);
+        --bit;
+        continue;
+      }
+      int low = std::max(bit - int(windowSize) + 1, 0);
+      while (((k >> low) & 1) == 0)
+        ++low;
+      for (int i = low; i <= bit; ++i)
+        result = multiply(result, result);
+      result = multiply(result, odd[((k >> low) & ((2u << (bit - low)) - 1)) / 2]);
+      bit = low - 1;
+    }
+    return fromValue(result);
   }
 
   Residue<N>& operator+=(const Residue<N>& a) {
@@ -174,27 +215,82 @@ class Residue {
 
     unsigned f = phi<N>::value;
     unsigned ans = N;
+    PowTable<N> powers(*this, f);
     for (unsigned i = 1; i * i <= f; ++i) {
       if (f % i != 0)
         continue;
-      if (pow(i).value == 1)
+      if (powers.pow(i).value == 1)
         return i;
-      if (pow(f / i).value == 1)
+      if (powers.pow(f / i).value == 1)
         ans = std::min(ans, f / i);
     }
     return ans;
   }
 
+  // Extended Euclid, so it works for any N as long as gcd(value, N) = 1;
+  // returns 0 for non-invertible values, like order() does.
+  Residue<N> getEuclidInverse() const {
+    long long a = value, b = N, x = 1, y = 0;
+    while (b != 0) {
+      long long q = a / b;
+      a -= q * b;
+      std::swap(a, b);
+      x -= q * y;
+      std::swap(x, y);
+    }
+    if (a != 1)
+      return Residue<N>(0);
+    return Residue<N>(int((x % (long long)N + N) % N));
+  }
+
   Residue<N>& operator/=(const Residue<N>& a);
   Residue<N> getInverse() const;
 
   static Residue<N> getPrimitiveRoot();
 };
 
+// Fixed-base exponentiation: for every 4-bit digit position i of the
+// exponent stores base^(j * 16^i), j < 16, so pow(k) is one lookup and
+// multiplication per nonzero digit of k, at most 8. Pays off when the
+// same base is raised to many exponents, as in order() or hashing.
+template<unsigned N>
+class PowTable {
+  static const unsigned digitBits = 4;
+  static const unsigned digitCount = 1 << digitBits;
+  unsigned digits = 1;
+  std::vector<Residue<N>> table;
+
+ public:
+  // Exponents up to maxExponent are looked up; larger ones fall back to
+  // Residue<N>::pow.
+  explicit PowTable(const Residue<N>& base, unsigned maxExponent = ~0u) {
+    while (digits * digitBits < 32 && (maxExponent >> (digits * digitBits)) != 0)
+      ++digits;
+    table.reserve(digits * digitCount);
+    Residue<N> power = base;
+    for (unsigned i = 0; i < digits; ++i) {
+      table.push_back(Residue<N>(1));
+      for (unsigned j = 1; j < digitCount; ++j)
+        table.push_back(table.back() * power);
+      power = table.back() * power;
+    }
+  }
+
+  Residue<N> pow(unsigned k) const {
+    if (digits * digitBits < 32 && (k >> (digits * digitBits)) != 0)
+      return table[1].pow(k);
+    Residue<N> result(1);
+    for (size_t i = 0; k != 0; ++i, k >>= digitBits)
+      if ((k & (digitCount - 1)) != 0)
+        result *= table[i * digitCount + (k & (digitCount - 1))];
+    return result;
+  }
+};
+
 template<unsigned N, unsigned T>
 struct inv {
   static Residue<N> getInverse(const Residue<N>& r) {
-    return r.pow(N - 2);
+    return r.getEuclidInverse();
   }
   static void divide(Residue<N>& r1, const Residue<N>& r2) {
     r1 *= getInverse(r2);
@@ -277,6 +373,16 @@ Residue<N> operator/(const Residue<N>& r1, const Residue<N>& r2) {
   return r;
 }
 
+template<unsigned N>
+bool operator==(const Residue<N>& a, const Residue<N>& b) {
+  return int(a) == int(b);
+}
+
+template<unsigned N>
+bool operator!=(const Residue<N>& a, const Residue<N>& b) {
+  return !(a == b);
+}
+
 template<unsigned N>
 Residue<N> operator+(const Residue<N>& a, const Residue<N>& b) {
   Residue<N> c = a;
@@ -296,4 +402,32 @@ Residue<N> operator*(const Residue<N>& a, const Residue<N>& b) {
   Residue<N> c = a;
   c *= b;
   return c;
-}
\ No newline at end of file
+}
+
+// Montgomery's trick: inverts count elements in place with 3(count - 1)
+// multiplications and a single inversion. Zeros are left as they are, every
+// other element must be invertible.
+template<unsigned N>
+void invert_many(Residue<N>* first, size_t count) {
+  std::vector<Residue<N>> prefix;
+  prefix.reserve(count);
+  Residue<N> product(1);
+  for (size_t i = 0; i < count; ++i) {
+    prefix.push_back(product);
+    if (int(first[i]) != 0)
+      product *= first[i];
+  }
+  Residue<N> inverse = product.getEuclidInverse();
+  for (size_t i = count; i > 0; --i) {
+    if (int(first[i - 1]) == 0)
+      continue;
+    Residue<N> x = first[i - 1];
+    first[i - 1] = inverse * prefix[i - 1];
+    inverse *= x;
+  }
+}
+
+template<unsigned N>
+void invert_many(std::vector<Residue<N>>& a) {
+  invert_many(a.data(), a.size());
+}
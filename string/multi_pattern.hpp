@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+#include "string.hpp"
+
+// Aho-Corasick automaton over a fixed set of patterns. The text is read
+// once, one table lookup per byte, however many patterns there are.
+//
+// The transition table is a complete DFA stored in one flat array. Bytes
+// that occur in no pattern share class 0, so a row has only as many columns
+// as there are distinct pattern bytes plus one, and the whole table of a
+// few thousand keywords stays in cache. Entries hold the target row offset
+// (state * width) rather than the state, and the top bit marks states that
+// end at least one pattern, so the scan loop needs no multiplication and
+// no second lookup for the common state without matches.
+class MultiPatternMatcher {
+ private:
+  // Enumerators rather than static members, so that binding them to a
+  // const reference needs no out-of-class definition.
+  enum : uint32_t {
+    matchReportBit = 1u << 31,
+    noPattern = UINT32_MAX
+  };
+
+  uint32_t width_ = 1;
+  uint32_t classOf_[256];
+  std::vector<uint32_t> next_;
+  std::vector<uint32_t> firstPattern_;  // per state, or noPattern
+  std::vector<uint32_t> outputLink_;    // nearest proper suffix state with a pattern, or 0
+  std::vector<uint32_t> samePattern_;   // next pattern equal to this one, or noPattern
+  std::vector<size_t> lengths_;
+
+  uint32_t addState() {
+    if ((next_.size() + width_) >= matchReportBit)
+      throw std::length_error("Too many patterns for MultiPatternMatcher");
+    next_.resize(next_.size() + width_, 0);
+    firstPattern_.push_back(noPattern);
+    outputLink_.push_back(0);
+    return static_cast<uint32_t>(firstPattern_.size() - 1);
+  }
+
+  template<typename F>
+  void report(uint32_t state, size_t end, F& onMatch) const {
+    for (; state != 0; state = outputLink_[state])
+      for (uint32_t p = firstPattern_[state]; p != noPattern; p = samePattern_[p])
+        onMatch(end - lengths_[p], static_cast<size_t>(p));
+  }
+
+  // Runs the automaton over text[0, n) from row offset at, where text[0]
+  // is at offset base of the whole input, and returns the final row.
+  template<typename F>
+  uint32_t scanBlock(const char* text, size_t n, size_t base, uint32_t at, F& onMatch) const {
+    const uint32_t* next = next_.data();
+    for (size_t i = 0; i < n; ++i) {
+      at = next[at + classOf_[static_cast<unsigned char>(text[i])]];
+      if (at & matchReportBit) {
+        at &= ~matchReportBit;
+        report(at / width_, base + i + 1, onMatch);
+      }
+    }
+    return at;
+  }
+
+ public:
+  struct Match {
+    size_t position;
+    size_t pattern;  // index in the pattern list
+  };
+
+  // Empty patterns never match. Throws std::length_error if the automaton
+  // would not fit in 31-bit offsets.
+  explicit MultiPatternMatcher(const std::vector<String>& patterns)
+      : samePattern_(patterns.size(), noPattern), lengths_(patterns.size()) {
+    for (size_t c = 0; c < 256; ++c)
+      classOf_[c] = 0;
+    for (const String& pattern : patterns)
+      for (size_t i = 0; i < pattern.length(); ++i) {
+        uint32_t& cls = classOf_[static_cast<unsigned char>(pattern[i])];
+        if (cls == 0)
+          cls = width_++;
+      }
+
+    // Trie; 0 marks a missing child, since no edge leads back to the root.
+    addState();
+    for (size_t p = 0; p < patterns.size(); ++p) {
+      const String& pattern = patterns[p];
+      lengths_[p] = pattern.length();
+      if (pattern.empty())
+        continue;
+      uint32_t state = 0;
+      for (size_t i = 0; i < pattern.length(); ++i) {
+        size_t edge = state * width_ + classOf_[static_cast<unsigned char>(pattern[i])];
+        if (next_[edge] == 0) {
+          uint32_t child = addState();
+          next_[edge] = child;
+        }
+        state = next_[edge];
+      }
+      samePattern_[p] = firstPattern_[state];
+      firstPattern_[state] = static_cast<uint32_t>(p);
+    }
+
+    // Breadth-first completion: a missing edge takes the edge of the
+    // failure state, which lies on a lower level and is already complete.
+    std::vector<uint32_t> fail(firstPattern_.size(), 0);
+    std::queue<uint32_t> order;
+    for (uint32_t c = 0; c < width_; ++c)
+      if (next_[c] != 0)
+        order.push(next_[c]);
+    while (!order.empty()) {
+      uint32_t state = order.front();
+      order.pop();
+      for (uint32_t c = 0; c < width_; ++c) {
+        uint32_t& edge = next_[state * width_ + c];
+        uint32_t fallback = next_[fail[state] * width_ + c];
+        if (edge == 0) {
+          edge = fallback;
+          continue;
+        }
+        fail[edge] = fallback;
+        outputLink_[edge] = firstPattern_[fallback] != noPattern ? fallback : outputLink_[fallback];
+        order.push(edge);
+      }
+    }
+
+    for (uint32_t& edge : next_) {
+      bool matches = firstPattern_[edge] != noPattern || outputLink_[edge] != 0;
+      edge = edge * width_ | (matches ? uint32_t(matchReportBit) : 0u);
+    }
+  }
+
+  size_t size() const {
+    return lengths_.size();
+  }
+
+  // Calls onMatch(position, pattern) for every occurrence of every
+  // pattern, overlapping ones included, in order of the match end.
+  template<typename F>
+  void scan(StringView text, F onMatch) const {
+    scanBlock(text.data(), text.length(), 0, 0, onMatch);
+  }
+
+  // Same for a stream, read in large blocks until it ends; positions are
+  // offsets from where the stream was when scan was called. Matches may
+  // span block boundaries.
+  template<typename F>
+  void scan(std::istream& in, F onMatch) const {
+    const size_t blockSize = 1 << 16;
+    std::vector<char> block(blockSize);
+    uint32_t at = 0;
+    size_t base = 0;
+    while (in) {
+      in.read(block.data(), blockSize);
+      size_t n = static_cast<size_t>(in.gcount());
+      at = scanBlock(block.data(), n, base, at, onMatch);
+      base += n;
+    }
+  }
+
+  std::vector<Match> find_all(StringView text) const {
+    std::vector<Match> matches;
+    scan(text, [&matches](size_t position, size_t pattern) {
+      matches.push_back(Match{position, pattern});
+    });
+    return matches;
+  }
+};
@@ -0,0 +1,403 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "string.hpp"
+
+// Text stored as a sequence of String chunks of at most ChunkSize
+// characters, kept in a treap ordered by position: every node holds one
+// chunk and the number of characters in its subtree, and random priorities
+// keep the expected depth logarithmic. Insert, erase, concatenation and
+// indexing split and merge O(log n) nodes and copy at most two chunks, so
+// editing the middle of a large text never moves the rest of it.
+//
+// Every rope draws its priorities from its own xorshift sequence, seeded
+// from a global counter: ropes sharing one sequence would give their first
+// nodes equal priorities, and concatenating many of them would build a
+// list instead of a balanced tree. Split, merge, copy and destruction are
+// iterative, so even an unlucky tree cannot overflow the stack.
+class Rope {
+ private:
+  static const size_t ChunkSize = 1024;
+
+  struct Node {
+    String chunk;
+    size_t size;
+    uint32_t priority;
+    Node* left = nullptr;
+    Node* right = nullptr;
+
+    Node(StringView text, uint32_t priority): chunk(text), size(text.length()), priority(priority) {}
+  };
+
+  // Declared before root_, which build() initialises.
+  uint32_t seed_ = newSeed();  // xorshift state
+  std::vector<Node*> path_;    // scratch for split and merge
+  Node* root_ = nullptr;
+
+  // Distinct, well mixed and never zero for every call.
+  static uint32_t newSeed() {
+    static std::atomic<uint32_t> counter(0);
+    uint32_t x = counter.fetch_add(1, std::memory_order_relaxed) * 0x9e3779b9u + 0x7f4a7c15u;
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    return x == 0 ? 1 : x;
+  }
+
+  uint32_t nextPriority() {
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    return seed_;
+  }
+
+  static size_t sizeOf(const Node* t) {
+    return t == nullptr ? 0 : t->size;
+  }
+
+  static void update(Node* t) {
+    t->size = sizeOf(t->left) + t->chunk.length() + sizeOf(t->right);
+  }
+
+  static void destroy(Node* t) {
+    std::vector<Node*> pending;
+    if (t != nullptr)
+      pending.push_back(t);
+    while (!pending.empty()) {
+      t = pending.back();
+      pending.pop_back();
+      if (t->left != nullptr)
+        pending.push_back(t->left);
+      if (t->right != nullptr)
+        pending.push_back(t->right);
+      delete t;
+    }
+  }
+
+  // Recomputes the sizes of the nodes pushed on path_ since it had length
+  // base, deepest first, and pops them.
+  void updatePath(size_t base) {
+    for (size_t i = path_.size(); i > base; --i)
+      update(path_[i - 1]);
+    path_.resize(base);
+  }
+
+  static Node* clone(const Node* t) {
+    Node* root = nullptr;
+    std::vector<std::pair<const Node*, Node**>> pending;
+    if (t != nullptr)
+      pending.emplace_back(t, &root);
+    while (!pending.empty()) {
+      const Node* from = pending.back().first;
+      Node** slot = pending.back().second;
+      pending.pop_back();
+      Node* copy = new Node(from->chunk, from->priority);
+      copy->size = from->size;
+      *slot = copy;
+      if (from->left != nullptr)
+        pending.emplace_back(from->left, &copy->left);
+      if (from->right != nullptr)
+        pending.emplace_back(from->right, &copy->right);
+    }
+    return root;
+  }
+
+  // Every character of l goes before every character of r. Walks down the
+  // right spine of l and the left spine of r, linking the node of higher
+  // priority into the open slot at each step.
+  Node* merge(Node* l, Node* r) {
+    size_t base = path_.size();
+    Node* root = nullptr;
+    Node** slot = &root;
+    while (l != nullptr && r != nullptr) {
+      if (l->priority > r->priority) {
+        *slot = l;
+        path_.push_back(l);
+        slot = &l->right;
+        l = l->right;
+      } else {
+        *slot = r;
+        path_.push_back(r);
+        slot = &r->left;
+        r = r->left;
+      }
+    }
+    *slot = l != nullptr ? l : r;
+    updatePath(base);
+    return root;
+  }
+
+  // l gets the first k characters of t and r the rest; a chunk that
+  // straddles position k is cut in two. The second half keeps the priority
+  // of the node it was cut from, so it stays below every ancestor of the
+  // slot it is linked into and the heap order holds.
+  void split(Node* t, size_t k, Node*& l, Node*& r) {
+    size_t base = path_.size();
+    Node** left = &l;
+    Node** right = &r;
+    while (t != nullptr) {
+      path_.push_back(t);
+      size_t leftSize = sizeOf(t->left);
+      size_t chunkEnd = leftSize + t->chunk.length();
+      if (k <= leftSize) {
+        *right = t;
+        right = &t->left;
+        t = t->left;
+      } else if (k >= chunkEnd) {
+        *left = t;
+        left = &t->right;
+        k -= chunkEnd;
+        t = t->right;
+      } else {
+        size_t cut = k - leftSize;
+        Node* tail = new Node(t->chunk.substr_view(cut, t->chunk.length() - cut), t->priority);
+        t->chunk = String(t->chunk.substr_view(0, cut));
+        Node* rest = t->right;
+        t->right = nullptr;
+        *left = t;
+        *right = merge(tail, rest);
+        updatePath(base);
+        return;
+      }
+    }
+    *left = nullptr;
+    *right = nullptr;
+    updatePath(base);
+  }
+
+  Node* build(StringView text) {
+    Node* t = nullptr;
+    for (size_t i = 0; i < text.length(); i += ChunkSize)
+      t = merge(t, new Node(text.substr(i, ChunkSize), nextPriority()));
+    return t;
+  }
+
+  // Appends text to the last chunk of t if it fits there, so that typing
+  // character by character does not leave a node per character.
+  static bool appendToLastChunk(Node* t, StringView text) {
+    if (t == nullptr)
+      return false;
+    Node* last = t;
+    while (last->right != nullptr)
+      last = last->right;
+    if (last->chunk.length() + text.length() > ChunkSize)
+      return false;
+    last->chunk += text;
+    for (Node* node = t; node != nullptr; node = node->right)
+      node->size += text.length();
+    return true;
+  }
+
+ public:
+  // Forward iterator over the characters, walking the chunks in order.
+  class const_iterator {
+   private:
+    std::vector<const Node*> path_;
+    const Node* node_ = nullptr;
+    size_t offset_ = 0;
+
+    void descend(const Node* t) {
+      for (; t != nullptr; t = t->left)
+        path_.push_back(t);
+    }
+
+    void nextChunk() {
+      offset_ = 0;
+      if (path_.empty()) {
+        node_ = nullptr;
+        return;
+      }
+      node_ = path_.back();
+      path_.pop_back();
+      descend(node_->right);
+    }
+
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef char value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const char* pointer;
+    typedef const char& reference;
+
+    const_iterator() = default;
+
+    explicit const_iterator(const Node* root) {
+      descend(root);
+      nextChunk();
+    }
+
+    reference operator*() const {
+      return node_->chunk[offset_];
+    }
+
+    pointer operator->() const {
+      return &node_->chunk[offset_];
+    }
+
+    const_iterator& operator++() {
+      if (++offset_ == node_->chunk.length())
+        nextChunk();
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const const_iterator& it) const {
+      return node_ == it.node_ && offset_ == it.offset_;
+    }
+
+    bool operator!=(const const_iterator& it) const {
+      return !(*this == it);
+    }
+  };
+
+  Rope() = default;
+
+  Rope(StringView text): root_(build(text)) {}
+
+  Rope(const Rope& r): root_(clone(r.root_)) {}
+
+  Rope(Rope&& r) noexcept: root_(r.root_) {
+    r.root_ = nullptr;
+  }
+
+  void swap(Rope& r) {
+    std::swap(root_, r.root_);
+  }
+
+  Rope& operator=(const Rope& r) {
+    if (this == &r)
+      return *this;
+    Rope temp = r;
+    swap(temp);
+    return *this;
+  }
+
+  Rope& operator=(Rope&& r) noexcept {
+    if (this == &r)
+      return *this;
+    Rope temp(std::move(r));
+    swap(temp);
+    return *this;
+  }
+
+  ~Rope() {
+    destroy(root_);
+  }
+
+  size_t length() const {
+    return sizeOf(root_);
+  }
+
+  bool empty() const {
+    return root_ == nullptr;
+  }
+
+  const char& operator[](size_t index) const {
+    const Node* t = root_;
+    while (true) {
+      size_t leftSize = sizeOf(t->left);
+      if (index < leftSize) {
+        t = t->left;
+      } else if (index < leftSize + t->chunk.length()) {
+        return t->chunk[index - leftSize];
+      } else {
+        index -= leftSize + t->chunk.length();
+        t = t->right;
+      }
+    }
+  }
+
+  // Inserts text before position pos, 0 <= pos <= length().
+  void insert(size_t pos, StringView text) {
+    if (text.empty())
+      return;
+    Node* l;
+    Node* r;
+    split(root_, pos, l, r);
+    if (!appendToLastChunk(l, text))
+      l = merge(l, build(text));
+    root_ = merge(l, r);
+  }
+
+  // Removes count characters starting at pos, cut at the end of the rope.
+  void erase(size_t pos, size_t count) {
+    Node* l;
+    Node* middle;
+    Node* r;
+    split(root_, pos, l, middle);
+    split(middle, count, middle, r);
+    destroy(middle);
+    root_ = merge(l, r);
+  }
+
+  Rope& append(StringView text) {
+    insert(length(), text);
+    return *this;
+  }
+
+  // Takes over the chunks of r, which is left empty.
+  Rope& append(Rope&& r) {
+    root_ = merge(root_, r.root_);
+    r.root_ = nullptr;
+    return *this;
+  }
+
+  Rope& operator+=(StringView text) {
+    return append(text);
+  }
+
+  Rope& operator+=(Rope&& r) {
+    return append(std::move(r));
+  }
+
+  void clear() {
+    destroy(root_);
+    root_ = nullptr;
+  }
+
+  const_iterator begin() const {
+    return const_iterator(root_);
+  }
+
+  const_iterator end() const {
+    return const_iterator();
+  }
+
+  // Calls f(StringView) on the chunks in order.
+  template<typename F>
+  void for_each_chunk(F f) const {
+    std::vector<const Node*> path;
+    for (const Node* t = root_; t != nullptr || !path.empty(); t = t->right) {
+      for (; t != nullptr; t = t->left)
+        path.push_back(t);
+      t = path.back();
+      path.pop_back();
+      f(StringView(t->chunk));
+    }
+  }
+
+  explicit operator String() const {
+    String result;
+    result.reserve(length());
+    for_each_chunk([&result](StringView chunk) {
+      result += chunk;
+    });
+    return result;
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const Rope& r) {
+  r.for_each_chunk([&out](StringView chunk) {
+    out << chunk;
+  });
+  return out;
+}
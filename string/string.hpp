@@ -1,28 +1,32 @@
+#pragma once
+
 #include <iostream>
 #include <cstring>
+#include "string_view.hpp"
 
+// Strings of up to InlineCapacity characters live in the object itself and
+// never allocate; str points either to local or to a heap buffer.
 class String {
  private:
-  size_t realSize = 0;
-  size_t bufferSize = 0;
-  char* str = nullptr;
-  static const size_t MinimalBufferSize;
+  static const size_t InlineCapacity = 16;
   static const size_t ExpansionCoefficient = 2;
+  size_t realSize = 0;
+  size_t bufferSize = InlineCapacity;
+  char local[InlineCapacity];
+  char* str = local;
 
-  bool isSame(const String& substring, size_t i) const {
-    bool allow = false;
-    for (size_t j = i; j <= i + substring.realSize - 1; ++j)
-      if ((allow = (str[j] != substring[j - i])))
-        break;
-    return !allow;
+  bool isLocal() const {
+    return str == local;
   }
 
  public:
   String() = default;
 
   String(size_t sz): realSize(sz) {
-    bufferSize = std::max(sz, MinimalBufferSize);
-    str = new char[bufferSize];
+    if (sz > InlineCapacity) {
+      bufferSize = sz;
+      str = new char[bufferSize];
+    }
   }
 
   String(size_t sz, char c): String(sz) {
@@ -33,14 +37,43 @@ class String {
     memcpy(str, s.str, realSize);
   }
 
+  // Takes over the heap buffer of s, which is left empty.
+  String(String&& s) noexcept: realSize(s.realSize), bufferSize(s.bufferSize) {
+    if (s.isLocal()) {
+      memcpy(local, s.local, realSize);
+    } else {
+      str = s.str;
+      s.str = s.local;
+      s.bufferSize = InlineCapacity;
+    }
+    s.realSize = 0;
+  }
+
   String(const char* s): String(strlen(s)) {
     memcpy(str, s, realSize);
   }
 
   String(char c): String(1, c) {}
 
+  explicit String(StringView s): String(s.length()) {
+    memcpy(str, s.data(), realSize);
+  }
+
   void swap(String& s) {
+    bool wasLocal = isLocal();
+    bool otherWasLocal = s.isLocal();
+    char buffer[InlineCapacity];
+    if (wasLocal)
+      memcpy(buffer, local, realSize);
+    if (otherWasLocal)
+      memcpy(local, s.local, s.realSize);
+    if (wasLocal)
+      memcpy(s.local, buffer, realSize);
     std::swap(str, s.str);
+    if (otherWasLocal)
+      str = local;
+    if (wasLocal)
+      s.str = s.local;
     std::swap(realSize, s.realSize);
     std::swap(bufferSize, s.bufferSize);
   }
@@ -53,54 +86,135 @@ class String {
     return *this;
   }
 
+  String& operator=(String&& s) noexcept {
+    if (this == &s)
+      return *this;
+    String temp(std::move(s));
+    swap(temp);
+    return *this;
+  }
+
+  size_t capacity() const {
+    return bufferSize;
+  }
+
+  // Makes room for at least capacity characters without changing the
+  // contents, so that appending up to that length does not reallocate.
+  void reserve(size_t capacity) {
+    if (capacity <= bufferSize)
+      return;
+    char* buffer = new char[capacity];
+    memcpy(buffer, str, realSize);
+    if (!isLocal())
+      delete[] str;
+    str = buffer;
+    bufferSize = capacity;
+  }
+
+  // Keeps the buffer when shrinking, so a String reused for many values
+  // allocates only when it outgrows it.
+  void resize(size_t size, char c = '\0') {
+    reserve(size);
+    if (size > realSize)
+      memset(str + realSize, c, size - realSize);
+    realSize = size;
+  }
+
+  void shrink_to_fit() {
+    if (isLocal() || bufferSize == realSize)
+      return;
+    String temp(realSize);
+    memcpy(temp.str, str, realSize);
+    swap(temp);
+  }
+
   void push_back(char c) {
     if (realSize < bufferSize) {
       str[realSize++] = c;
       return;
     }
-    String temp(bufferSize * ExpansionCoefficient);
-    swap(temp);
-    realSize = temp.realSize;
-    memcpy(str, temp.str, realSize);
+    reserve(bufferSize * ExpansionCoefficient);
     str[realSize++] = c;
   }
 
   void pop_back() {
-    if ((--realSize) * ExpansionCoefficient * ExpansionCoefficient < bufferSize) {
+    if ((--realSize) * ExpansionCoefficient * ExpansionCoefficient < bufferSize && !isLocal()) {
       String temp(bufferSize /= ExpansionCoefficient);
       swap(temp);
       memcpy(str, temp.str, realSize = temp.realSize);
     }
   }
 
-  String& operator+=(const String& s) {
-    size_t length = s.realSize;
-    if (realSize * ExpansionCoefficient * ExpansionCoefficient < s.realSize) {
-      String temp(realSize + s.realSize);
-      memcpy(temp.str, str, realSize);
-      memcpy(temp.str + realSize, s.str, s.realSize);
-      swap(temp);
-      return *this;
+  // Grows the buffer at most once, geometrically, and copies with memcpy.
+  // s may point into this string.
+  String& append(const char* s, size_t length) {
+    if (realSize + length > bufferSize) {
+      size_t capacity = std::max(realSize + length, bufferSize * ExpansionCoefficient);
+      char* buffer = new char[capacity];
+      memcpy(buffer, str, realSize);
+      memcpy(buffer + realSize, s, length);
+      if (!isLocal())
+        delete[] str;
+      str = buffer;
+      bufferSize = capacity;
+    } else {
+      memcpy(str + realSize, s, length);
     }
-    for (size_t i = 0; i < length; ++i)
-      push_back(s.str[i]);
+    realSize += length;
     return *this;
   }
 
-  size_t find(const String& substring) const {
-    for (size_t i = 0; i + substring.realSize < realSize + 1; ++i)
-      if (isSame(substring, i))
-        return i;
-    return realSize;
+  String& append(const char* s) {
+    return append(s, strlen(s));
   }
 
-  size_t rfind(const String& substring) const {
-    if (realSize < substring.realSize)
-      return realSize;
-    for (int i = realSize - substring.realSize; i >= 0; --i)
-      if (isSame(substring, i))
-        return i;
-    return realSize;
+  String& append(StringView s) {
+    return append(s.data(), s.length());
+  }
+
+  String& operator+=(StringView s) {
+    return append(s);
+  }
+
+  String& operator+=(const char* s) {
+    return append(s);
+  }
+
+  String& operator+=(char c) {
+    push_back(c);
+    return *this;
+  }
+
+  operator StringView() const {
+    return StringView(str, realSize);
+  }
+
+  size_t find(StringView substring, size_t pos = 0) const {
+    return StringView(*this).find(substring, pos);
+  }
+
+  size_t rfind(StringView substring, size_t pos) const {
+    return StringView(*this).rfind(substring, pos);
+  }
+
+  size_t rfind(StringView substring) const {
+    return StringView(*this).rfind(substring);
+  }
+
+  size_t find(char c, size_t pos = 0) const {
+    return StringView(*this).find(c, pos);
+  }
+
+  size_t rfind(char c, size_t pos) const {
+    return StringView(*this).rfind(c, pos);
+  }
+
+  size_t rfind(char c) const {
+    return StringView(*this).rfind(c);
+  }
+
+  std::vector<size_t> find_all(StringView substring) const {
+    return StringView(*this).find_all(substring);
   }
 
   String substr(size_t start, size_t count) const {
@@ -109,6 +223,11 @@ class String {
     return temp;
   }
 
+  // Same characters as substr, without allocating or copying.
+  StringView substr_view(size_t start, size_t count) const {
+    return StringView(*this).substr(start, count);
+  }
+
   bool empty() const {
     return realSize == 0;
   }
@@ -133,6 +252,10 @@ class String {
     return realSize;
   }
 
+  const char* data() const {
+    return str;
+  }
+
   char& operator[](size_t index) {
     return str[index];
   }
@@ -142,48 +265,87 @@ class String {
   }
 
   void clear() {
-    realSize = bufferSize = 0;
-    if (str != nullptr)
+    if (!isLocal())
       delete[] str;
-    str = nullptr;
+    str = local;
+    realSize = 0;
+    bufferSize = InlineCapacity;
   }
 
   ~String() {
-    if (str != nullptr)
+    if (!isLocal())
       delete[] str;
   }
 };
 
-const size_t String::MinimalBufferSize = 4;
+inline std::ostream& operator<<(std::ostream& out, const String& s) {
+  return out << StringView(s);
+}
 
-std::ostream &operator<<(std::ostream& out, const String& s) {
-  for (size_t i = 0; i < s.length(); ++i)
-    out << s[i];
-  return out;
+inline bool isWhitespace(int c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
 }
 
-std::istream& operator>>(std::istream& in, String& s) {
-  s.clear();
-  char c;
-  in >> c;
-  while (!isspace(c) && c != EOF) {
-    s.push_back(c);
-    c = in.get();
+// Appends characters from buffer to s until stop(c) holds or the input
+// ends, and returns that character or eof without extracting it. Reads
+// the stream buffer directly and appends in blocks, instead of one istream
+// call and one push_back per character.
+template<typename Stop>
+int appendUntil(std::streambuf* buffer, String& s, Stop stop) {
+  typedef std::char_traits<char> traits;
+  char block[256];
+  size_t n = 0;
+  int c = buffer->sgetc();
+  for (; c != traits::eof() && !stop(c); c = buffer->snextc()) {
+    block[n++] = traits::to_char_type(c);
+    if (n == sizeof(block)) {
+      s.append(block, n);
+      n = 0;
+    }
   }
+  s.append(block, n);
+  return c;
+}
+
+// Like std::string, the whitespace after the word is left in the stream and
+// the capacity of s is kept, so reading many words into one String does not
+// allocate for each of them.
+inline std::istream& operator>>(std::istream& in, String& s) {
+  s.resize(0);
+  std::istream::sentry sentry(in);
+  if (!sentry)
+    return in;
+  if (appendUntil(in.rdbuf(), s, isWhitespace) == std::char_traits<char>::eof())
+    in.setstate(s.empty() ? std::ios::eofbit | std::ios::failbit : std::ios::eofbit);
   return in;
 }
 
-bool operator==(const String& s1, const String& s2) {
-  if (s1.length() != s2.length())
-    return false;
-  for (size_t i = 0; i < s1.length(); ++i)
-    if (s1[i] != s2[i])
-      return false;
-  return true;
+// Reads up to delim, which is extracted but not stored. Fails only if
+// nothing at all could be extracted.
+inline std::istream& getline(std::istream& in, String& s, char delim = '\n') {
+  s.resize(0);
+  std::istream::sentry sentry(in, true);
+  if (!sentry)
+    return in;
+  int end = std::char_traits<char>::to_int_type(delim);
+  if (appendUntil(in.rdbuf(), s, [end](int c) { return c == end; }) == std::char_traits<char>::eof())
+    in.setstate(s.empty() ? std::ios::eofbit | std::ios::failbit : std::ios::eofbit);
+  else
+    in.rdbuf()->sbumpc();
+  return in;
 }
 
-String operator+(const String& s1, const String& s2) {
-  String temp = s1;
+inline String operator+(const String& s1, const String& s2) {
+  String temp;
+  temp.reserve(s1.length() + s2.length());
+  temp += s1;
   temp += s2;
   return temp;
 }
+
+// Appends to the buffer of a temporary left operand, so that a chain
+// a + b + c + ... reuses one geometrically growing buffer.
+inline String operator+(String&& s1, const String& s2) {
+  s1 += s2;
+  return std::move(s1);
+}
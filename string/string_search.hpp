@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Substring search over raw byte ranges. Every function returns the offset
+// of the match or the text length n when there is none, like String::find.
+//
+// Patterns up to ShortPatternLength bytes are found by comparing the first
+// and the last byte of the pattern against a whole vector of positions at
+// once and checking only the candidates with memcmp. Longer patterns use
+// the Two-Way algorithm, which never looks at a text byte more than twice
+// and so stays linear even for repetitive texts and patterns; a Horspool
+// table on the last byte lets it skip ahead on ordinary text.
+const size_t ShortPatternLength = 32;
+
+#if defined(__AVX2__)
+const size_t searchBlock = 32;
+
+// Bit j is set if x[j] == first and y[j] == last, j < searchBlock.
+inline uint32_t candidateMask(const char* x, const char* y, char first, char last) {
+  __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x)),
+                                _mm256_set1_epi8(first));
+  __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(y)),
+                                _mm256_set1_epi8(last));
+  return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(a, b)));
+}
+#elif defined(__SSE2__)
+const size_t searchBlock = 16;
+
+inline uint32_t candidateMask(const char* x, const char* y, char first, char last) {
+  __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x)),
+                             _mm_set1_epi8(first));
+  __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y)),
+                             _mm_set1_epi8(last));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(a, b)));
+}
+#else
+const size_t searchBlock = 8;
+
+inline uint32_t candidateMask(const char* x, const char* y, char first, char last) {
+  uint32_t mask = 0;
+  for (size_t j = 0; j < searchBlock; ++j)
+    if (x[j] == first && y[j] == last)
+      mask |= 1u << j;
+  return mask;
+}
+#endif
+
+inline bool matchesAt(const char* text, const char* pattern, size_t m, size_t i) {
+  return text[i] == pattern[0] && text[i + m - 1] == pattern[m - 1] &&
+         memcmp(text + i + 1, pattern + 1, m - 2) == 0;
+}
+
+// First match starting in [from, n - m], for 2 <= m <= n.
+inline size_t filterFind(const char* text, size_t n, const char* pattern, size_t m,
+                         size_t from) {
+  size_t i = from;
+  for (; i + m - 1 + searchBlock <= n; i += searchBlock) {
+    uint32_t mask = candidateMask(text + i, text + i + m - 1, pattern[0], pattern[m - 1]);
+    while (mask != 0) {
+      size_t j = i + __builtin_ctz(mask);
+      if (memcmp(text + j + 1, pattern + 1, m - 2) == 0)
+        return j;
+      mask &= mask - 1;
+    }
+  }
+  for (; i + m <= n; ++i)
+    if (matchesAt(text, pattern, m, i))
+      return i;
+  return n;
+}
+
+// Last match starting in [0, last], for 2 <= m and last + m <= n.
+inline size_t filterRfind(const char* text, size_t n, const char* pattern, size_t m,
+                          size_t last) {
+  size_t end = last + 1;  // candidates below end are left
+  for (; end >= searchBlock; end -= searchBlock) {
+    size_t i = end - searchBlock;
+    uint32_t mask = candidateMask(text + i, text + i + m - 1, pattern[0], pattern[m - 1]);
+    while (mask != 0) {
+      size_t bit = 31 - __builtin_clz(mask);
+      if (memcmp(text + i + bit + 1, pattern + 1, m - 2) == 0)
+        return i + bit;
+      mask &= ~(1u << bit);
+    }
+  }
+  for (; end > 0; --end)
+    if (matchesAt(text, pattern, m, end - 1))
+      return end - 1;
+  return n;
+}
+
+// Reads a byte range front to back or back to front, so that one Two-Way
+// implementation serves both find and rfind.
+template<bool Backward>
+struct search_direction {
+  static unsigned char at(const char* base, size_t /*length*/, size_t i) {
+    return base[i];
+  }
+};
+
+template<>
+struct search_direction<true> {
+  static unsigned char at(const char* base, size_t length, size_t i) {
+    return base[length - 1 - i];
+  }
+};
+
+// Crochemore-Perrin Two-Way search. The pattern is split at a critical
+// position: the right part is matched left to right, the left part right
+// to left, and shifts use the period of the pattern, remembering the
+// already matched prefix (mem) for periodic patterns.
+template<bool Backward>
+class TwoWaySearcher {
+ private:
+  typedef search_direction<Backward> direction;
+  const char* pattern_;
+  size_t m_;
+  size_t split_;   // critical position minus one, may wrap to SIZE_MAX
+  size_t period_;
+  size_t memory_;  // prefix known to match after a period shift, or 0
+  size_t shift_[256];
+  bool present_[256];
+
+  unsigned char at(size_t i) const {
+    return direction::at(pattern_, m_, i);
+  }
+
+  // Start (minus one) and period of the maximal suffix of the pattern for
+  // the byte order given by Greater.
+  template<bool Greater>
+  void maximalSuffix(size_t& start, size_t& period) const {
+    size_t ip = static_cast<size_t>(-1);
+    size_t jp = 0;
+    size_t k = 1;
+    size_t p = 1;
+    while (jp + k < m_) {
+      unsigned char a = at(ip + k);
+      unsigned char b = at(jp + k);
+      if (a == b) {
+        if (k == p) {
+          jp += p;
+          k = 1;
+        } else {
+          ++k;
+        }
+      } else if (Greater ? a > b : a < b) {
+        jp += k;
+        k = 1;
+        p = jp - ip;
+      } else {
+        ip = jp++;
+        k = p = 1;
+      }
+    }
+    start = ip;
+    period = p;
+  }
+
+ public:
+  TwoWaySearcher(const char* pattern, size_t m) : pattern_(pattern), m_(m) {
+    memset(present_, 0, sizeof(present_));
+    for (size_t i = 0; i < m_; ++i) {
+      present_[at(i)] = true;
+      shift_[at(i)] = i + 1;
+    }
+    size_t start, period, reverseStart, reversePeriod;
+    maximalSuffix<true>(start, period);
+    maximalSuffix<false>(reverseStart, reversePeriod);
+    if (reverseStart + 1 > start + 1) {
+      start = reverseStart;
+      period = reversePeriod;
+    }
+    split_ = start;
+    bool periodic = true;
+    for (size_t i = 0; i < split_ + 1 && periodic; ++i)
+      periodic = at(i) == at(i + period);
+    if (periodic) {
+      period_ = period;
+      memory_ = m_ - period;
+    } else {
+      period_ = std::max(split_, m_ - split_ - 1) + 1;
+      memory_ = 0;
+    }
+  }
+
+  // First match at or after from in the direction of the search, counted
+  // from that end of the text; n if there is none.
+  size_t find(const char* text, size_t n, size_t from) const {
+    size_t h = from;
+    size_t mem = 0;
+    while (n - h >= m_) {
+      unsigned char c = direction::at(text, n, h + m_ - 1);
+      if (!present_[c]) {
+        h += m_;
+        mem = 0;
+        continue;
+      }
+      size_t k = m_ - shift_[c];
+      if (k != 0) {
+        h += std::max(k, mem);
+        mem = 0;
+        continue;
+      }
+      for (k = std::max(split_ + 1, mem); k < m_ && at(k) == direction::at(text, n, h + k); ++k) {}
+      if (k < m_) {
+        h += k - split_;
+        mem = 0;
+        continue;
+      }
+      for (k = split_ + 1; k > mem && at(k - 1) == direction::at(text, n, h + k - 1); --k) {}
+      if (k <= mem)
+        return h;
+      h += period_;
+      mem = memory_;
+    }
+    return n;
+  }
+};
+
+// First occurrence of pattern starting at or after from.
+inline size_t searchForward(const char* text, size_t n, const char* pattern, size_t m,
+                            size_t from) {
+  if (m > n || from > n - m)
+    return n;
+  if (m == 0)
+    return from;
+  if (m == 1) {
+    const void* found = memchr(text + from, pattern[0], n - from);
+    return found == nullptr ? n : static_cast<const char*>(found) - text;
+  }
+  if (m <= ShortPatternLength)
+    return filterFind(text, n, pattern, m, from);
+  return TwoWaySearcher<false>(pattern, m).find(text, n, from);
+}
+
+// Last occurrence of pattern starting at or before last.
+inline size_t searchBackward(const char* text, size_t n, const char* pattern, size_t m,
+                             size_t last) {
+  if (m > n)
+    return n;
+  last = std::min(last, n - m);
+  if (m == 0)
+    return last;
+  if (m == 1) {
+    for (size_t i = last + 1; i > 0; --i)
+      if (text[i - 1] == pattern[0])
+        return i - 1;
+    return n;
+  }
+  if (m <= ShortPatternLength)
+    return filterRfind(text, n, pattern, m, last);
+  // Searching the reversed prefix that ends with the last candidate.
+  size_t length = last + m;
+  size_t found = TwoWaySearcher<true>(pattern, m).find(text, length, 0);
+  return found == length ? n : length - found - m;
+}
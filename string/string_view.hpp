@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include "string_search.hpp"
+
+// Non-owning reference to length characters at str. A view stays valid only
+// as long as the characters it points to, so views of a String are
+// invalidated by anything that reallocates or destroys that String.
+class StringView {
+ private:
+  const char* str_ = nullptr;
+  size_t length_ = 0;
+
+ public:
+  StringView() = default;
+
+  StringView(const char* s, size_t length): str_(s), length_(length) {}
+
+  StringView(const char* s): str_(s), length_(strlen(s)) {}
+
+  const char* data() const {
+    return str_;
+  }
+
+  size_t length() const {
+    return length_;
+  }
+
+  bool empty() const {
+    return length_ == 0;
+  }
+
+  const char& operator[](size_t index) const {
+    return str_[index];
+  }
+
+  const char& front() const {
+    return str_[0];
+  }
+
+  const char& back() const {
+    return str_[length_ - 1];
+  }
+
+  // count characters from start, cut at the end of the view; no copying.
+  StringView substr(size_t start, size_t count) const {
+    return StringView(str_ + start, std::min(count, length_ - start));
+  }
+
+  // First occurrence starting at or after pos; length() if there is none.
+  size_t find(StringView substring, size_t pos = 0) const {
+    return searchForward(str_, length_, substring.str_, substring.length_, pos);
+  }
+
+  // Last occurrence starting at or before pos; length() if there is none.
+  size_t rfind(StringView substring, size_t pos) const {
+    return searchBackward(str_, length_, substring.str_, substring.length_, pos);
+  }
+
+  size_t rfind(StringView substring) const {
+    return rfind(substring, length_);
+  }
+
+  size_t find(char c, size_t pos = 0) const {
+    return find(StringView(&c, 1), pos);
+  }
+
+  size_t rfind(char c, size_t pos) const {
+    return rfind(StringView(&c, 1), pos);
+  }
+
+  size_t rfind(char c) const {
+    return rfind(c, length_);
+  }
+
+  // Starting positions of all, possibly overlapping, occurrences.
+  std::vector<size_t> find_all(StringView substring) const {
+    std::vector<size_t> positions;
+    size_t m = substring.length_;
+    if (m == 0 || m > length_)
+      return positions;
+    if (m > ShortPatternLength) {
+      TwoWaySearcher<false> searcher(substring.str_, m);
+      for (size_t i = searcher.find(str_, length_, 0); i != length_;
+           i = searcher.find(str_, length_, i + 1))
+        positions.push_back(i);
+      return positions;
+    }
+    for (size_t i = find(substring); i != length_; i = find(substring, i + 1))
+      positions.push_back(i);
+    return positions;
+  }
+
+  // Negative, zero or positive as this view orders before, equal to or
+  // after s, comparing bytes as unsigned char.
+  int compare(StringView s) const {
+    size_t common = std::min(length_, s.length_);
+    int result = common == 0 ? 0 : memcmp(str_, s.str_, common);
+    if (result != 0)
+      return result;
+    return length_ < s.length_ ? -1 : (length_ > s.length_ ? 1 : 0);
+  }
+};
+
+inline bool operator==(StringView s1, StringView s2) {
+  return s1.length() == s2.length() &&
+         (s1.length() == 0 || memcmp(s1.data(), s2.data(), s1.length()) == 0);
+}
+
+inline bool operator!=(StringView s1, StringView s2) {
+  return !(s1 == s2);
+}
+
+// A char compares like a one-character string.
+inline bool operator==(StringView s, char c) {
+  return s == StringView(&c, 1);
+}
+
+inline bool operator==(char c, StringView s) {
+  return s == c;
+}
+
+inline bool operator!=(StringView s, char c) {
+  return !(s == c);
+}
+
+inline bool operator!=(char c, StringView s) {
+  return !(s == c);
+}
+
+inline bool operator<(StringView s1, StringView s2) {
+  return s1.compare(s2) < 0;
+}
+
+inline bool operator>(StringView s1, StringView s2) {
+  return s2 < s1;
+}
+
+inline bool operator<=(StringView s1, StringView s2) {
+  return !(s2 < s1);
+}
+
+inline bool operator>=(StringView s1, StringView s2) {
+  return !(s1 < s2);
+}
+
+inline std::ostream& operator<<(std::ostream& out, StringView s) {
+  return out.write(s.data(), s.length());
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstring>
+#include <istream>
+#include <vector>
+#include "string.hpp"
+
+// Splits a stream into whitespace-separated tokens or lines, reading it in
+// large blocks straight from its std::streambuf. next and getline return
+// views into the internal buffer, so a token costs no allocation and no
+// per-character stream call; a view stays valid until the next call. Input
+// is read ahead, so the stream should not be used directly afterwards.
+class TokenReader {
+ private:
+  static const size_t DefaultBufferSize = 1 << 16;
+  std::streambuf* source_;
+  std::vector<char> buffer_;
+  size_t begin_ = 0;  // unread input is buffer_[begin_, end_)
+  size_t end_ = 0;
+
+  // Moves the unread input to the front, doubling the buffer if it is all
+  // unread, and reads more; false at the end of the input.
+  bool refill() {
+    if (begin_ > 0) {
+      memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+      end_ -= begin_;
+      begin_ = 0;
+    }
+    if (end_ == buffer_.size())
+      buffer_.resize(buffer_.size() * 2);
+    std::streamsize n = source_->sgetn(buffer_.data() + end_, buffer_.size() - end_);
+    end_ += static_cast<size_t>(n);
+    return n > 0;
+  }
+
+ public:
+  explicit TokenReader(std::streambuf* source, size_t bufferSize = DefaultBufferSize)
+      : source_(source), buffer_(bufferSize == 0 ? 1 : bufferSize) {}
+
+  explicit TokenReader(std::istream& in, size_t bufferSize = DefaultBufferSize)
+      : TokenReader(in.rdbuf(), bufferSize) {}
+
+  // Next whitespace-separated token; false if only whitespace is left.
+  bool next(StringView& token) {
+    while (true) {
+      while (begin_ < end_ && isWhitespace(buffer_[begin_]))
+        ++begin_;
+      if (begin_ < end_)
+        break;
+      if (!refill())
+        return false;
+    }
+    size_t i = begin_;
+    while (true) {
+      while (i < end_ && !isWhitespace(buffer_[i]))
+        ++i;
+      if (i < end_)
+        break;
+      size_t scanned = i - begin_;
+      bool more = refill();
+      i = begin_ + scanned;
+      if (!more)
+        break;
+    }
+    token = StringView(buffer_.data() + begin_, i - begin_);
+    begin_ = i;
+    return true;
+  }
+
+  // Copies the token into token, reusing its capacity.
+  bool next(String& token) {
+    StringView view;
+    if (!next(view))
+      return false;
+    token.resize(0);
+    token.append(view);
+    return true;
+  }
+
+  // Next line without its delim; false once the input is exhausted. A
+  // last line without delim is still returned.
+  bool getline(StringView& line, char delim = '\n') {
+    size_t i = begin_;
+    while (true) {
+      const void* found = memchr(buffer_.data() + i, delim, end_ - i);
+      if (found != nullptr) {
+        size_t end = static_cast<const char*>(found) - buffer_.data();
+        line = StringView(buffer_.data() + begin_, end - begin_);
+        begin_ = end + 1;
+        return true;
+      }
+      size_t scanned = end_ - begin_;
+      if (!refill())
+        break;
+      i = begin_ + scanned;
+    }
+    if (begin_ == end_)
+      return false;
+    line = StringView(buffer_.data() + begin_, end_ - begin_);
+    begin_ = end_;
+    return true;
+  }
+
+  bool getline(String& line, char delim = '\n') {
+    StringView view;
+    if (!getline(view, delim))
+      return false;
+    line.resize(0);
+    line.append(view);
+    return true;
+  }
+};